@@ -1,117 +1,12 @@
 #define GSL_THROW_ON_CONTRACT_VIOLATION
-#include <chrono>
-#include <condition_variable>
-#include <mutex>
-#include <optional>
+#include <module.hpp>
 
-#include <jack.hpp>
-
-#include <boost/accumulators/accumulators.hpp>
-#include <boost/accumulators/statistics/density.hpp>
-#include <boost/accumulators/statistics/mean.hpp>
-#include <boost/accumulators/statistics/variance.hpp>
-#include <boost/lockfree/spsc_queue.hpp>
-
-#include <sys/mman.h>
-
-class MIDILatency : public JACK::Client {
-  JACK::MIDIIn In; JACK::MIDIOut Out;
-  int MonotonicCount = 0;
-  boost::lockfree::spsc_queue<int, boost::lockfree::capacity<50>> Measurements;
-  std::condition_variable DataReady;
-  int MaxEvents;
-  bool Done = false;
-
-public:
-  explicit MIDILatency(std::chrono::seconds Duration)
-  : JACK::Client("MIDILatency")
-  , In(createMIDIIn("In")), Out(createMIDIOut("Out"))
-  , MaxEvents(sampleRate() * Duration.count() / 64)
-  {
-    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
-      throw std::system_error(errno, std::generic_category());
-    }
-    activate();
-  }
-
-  int process(int FrameCount) override {
-    auto const Frame = (MonotonicCount / FrameCount) % FrameCount;
-    Out.buffer(FrameCount)[Frame] = MIDI::SongPositionPointer {
-      (MonotonicCount + Frame) % (1 << 14)
-    };
-
-    for (auto &[Offset, Event]: In.buffer(FrameCount)) {
-      if (auto SPP = std::get_if<MIDI::SongPositionPointer>(&Event)) {
-        Measurements.push((MonotonicCount + Offset - *SPP) % (1 << 14));
-        DataReady.notify_one();
-      }
-    }
-
-    MonotonicCount += FrameCount;
-
-    return 0;
-  }
-
-  void done() {
-    Done = true;
-    DataReady.notify_one();
-  }
-
-  template<typename NoSignal, typename Progress>
-  auto get(NoSignal noSignal, Progress progress) {
-    boost::accumulators::accumulator_set<
-      decltype(Measurements)::value_type, boost::accumulators::features<
-        boost::accumulators::tag::count, boost::accumulators::tag::density,
-        boost::accumulators::tag::min, boost::accumulators::tag::max,
-        boost::accumulators::tag::mean, boost::accumulators::tag::variance
-      >
-    > Accumulator( boost::accumulators::tag::density::num_bins = 20
-                 , boost::accumulators::tag::density::cache_size = MaxEvents / 10
-                 );
-    auto args = [&] {
-      auto const SampleRate = sampleRate();
-      auto us = [=](auto Frames) {
-        return std::chrono::duration_cast<std::chrono::microseconds>(
-          std::chrono::duration<long double>(Frames) / SampleRate
-        );
-      };
-      return std::tuple(
-        us(boost::accumulators::min(Accumulator)),
-        us(boost::accumulators::mean(Accumulator)),
-        us(boost::accumulators::max(Accumulator)),
-        us(sqrt(boost::accumulators::variance(Accumulator))),
-        boost::accumulators::count(Accumulator) * 100 / MaxEvents
-      );
-    };
-
-    auto PreviousArgs = std::optional(args());
-    std::mutex Mutex;
-
-    for (auto Lock = std::unique_lock(Mutex);
-         !Done && boost::accumulators::count(Accumulator) < MaxEvents;
-         DataReady.wait_for(Lock, std::chrono::milliseconds(100))) {
-      if (Measurements.read_available() == 0) {
-        noSignal();
-        PreviousArgs.reset();
-      } else {
-        Measurements.consume_all(Accumulator);
-        decltype(PreviousArgs) Args = args();
-        if (Args != PreviousArgs) {
-          std::apply(progress, Args.value());
-          PreviousArgs = std::move(Args);
-        }
-      }
-    }
-
-    deactivate();
-
-    return Accumulator;
-  }
-  auto get() { return get([]{}, [](auto...){}); }
-};
+#include "MIDILatency.hpp"
 
+#include <cmath>
 #include <csignal>
-#include <iomanip>
+#include <fstream>
+#include <iostream>
 
 using namespace std::literals::chrono_literals;
 
@@ -146,47 +41,137 @@ public:
 
 } // namespace Console
 
-int main() {
-  MIDILatency Latency(5s);
-  //Latency.connect("MIDILatency:Out", "MIDILatency:In");
-  Latency.connect("alsa_midi:Hammerfall DSP HDSP MIDI 1 (out)", "MIDILatency:In");
-  Latency.connect("MIDILatency:Out", "alsa_midi:Hammerfall DSP HDSP MIDI 1 (in)");
+int saturate(MIDILatency &Latency) {
+  auto const Loads = Latency.saturate([&](MIDILatency::Load const &Load) {
+    std::uint64_t Lost = 0, Reordered = 0;
+    for (std::size_t I = 0; I < Latency.loops(); ++I) {
+      Lost += Load.Sent[I] - std::min(Load.Sent[I], Load.Received[I]);
+      Reordered += Load.Reordered[I];
+    }
+    std::cout << std::lround(Load.Rate) << " events/s:"
+              << " lost=" << Lost << " reordered=" << Reordered;
+    if (Load.Latency.count() > 0) {
+      report(std::cout, Load.Latency, " ");
+    } else {
+      std::cout << " No signal" << std::endl;
+    }
+  });
+
+  bool Saturated = false;
+  for (std::size_t I = 0; I < Latency.loops(); ++I) {
+    std::cout << MIDILatency::outName(I) << " -> " << MIDILatency::inName(I) << ": ";
+    auto const Failure = std::find_if(Loads.begin(), Loads.end(), [&](auto const &Load) {
+      return !Load.sustained(I);
+    });
+    if (Failure == Loads.begin()) {
+      std::cout << "Nothing sustained" << std::endl;
+    } else if (Failure == Loads.end()) {
+      std::cout << "Sustained at least " << std::lround(Loads.back().Rate) << " events/s" << std::endl;
+    } else {
+      std::cout << "Sustained " << std::lround(std::prev(Failure)->Rate) << " events/s" << std::endl;
+      Saturated = true;
+    }
+  }
+
+  return Saturated ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> Previous;
+  std::optional<std::string> Output;
+  std::vector<std::pair<std::string, std::string>> Devices;
+  std::size_t LoopCount = 0;
+  std::chrono::seconds Duration = 5s;
+  bool Stress = false;
+  for (int I = 1; I < argc; ++I) {
+    std::string const Argument = argv[I];
+    if (Argument == "-m" && I + 1 < argc) {
+      Previous.push_back(argv[++I]);
+    } else if (Argument == "-o" && I + 1 < argc) {
+      Output = argv[++I];
+    } else if (Argument == "-p" && I + 2 < argc) {
+      Devices.emplace_back(argv[I + 1], argv[I + 2]);
+      I += 2;
+    } else if (Argument == "-n" && I + 1 < argc) {
+      LoopCount = std::stoul(argv[++I]);
+    } else if (Argument == "-t" && I + 1 < argc) {
+      Duration = std::chrono::seconds(std::stoul(argv[++I]));
+    } else if (Argument == "-s") {
+      Stress = true;
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [-p PLAYBACK-PORT CAPTURE-PORT]... [-n LOOPS]"
+                   " [-s | -t SECONDS [-m MERGE-FILE]... [-o FILE]]" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+  LoopCount = std::max({ LoopCount, Devices.size(), std::size_t(1) });
+
+  JACK::ModuleClient<MIDILatency> Client("MIDILatency", std::nullopt, LoopCount, Duration,
+                                         Stress ? std::optional(MIDILatency::Ramp()) : std::nullopt);
+  auto &Latency = Client.module();
+  Client.activate();
+  for (std::size_t I = 0; I < Devices.size(); ++I) {
+    Latency.connectLoop(I, Devices[I].first, Devices[I].second);
+  }
 
   stopOnSignal(Latency);
+  if (Stress) return saturate(Latency);
 
-  auto const Accumulator = Latency.get(
+  auto const Histograms = Latency.get(
     [] { // No signal
       static Console::Spinner Spinner;
       std::flush(std::cout << "\33[2K\r" << "No signal " << Spinner() << '\r');
     },
-    [](auto Min, auto Mean, auto Max, auto Deviation, auto Percent) { // Progress
-      std::flush(
-        std::cout << "\33[2K\r"
-                  << "Min=" << Min.count() << "us"
-                  << " Mean=" << Mean.count() << "us"
-                  << " Max=" << Max.count() << "us"
-                  << " StdDev=" << Deviation.count() << "us"
-                  << " (" << Percent << "%)"
-                  << '\r'
-      );
+    [](auto Min, auto Median, auto P99, auto Max, auto Percent, auto Silent) { // Progress
+      std::cout << "\33[2K\r"
+                << "Min=" << Min.count() << "us"
+                << " P50=" << Median.count() << "us"
+                << " P99=" << P99.count() << "us"
+                << " Max=" << Max.count() << "us"
+                << " (" << Percent << "%)";
+      if (Silent > 0) std::cout << ' ' << Silent << " silent";
+      std::flush(std::cout << '\r');
     }
   );
-  auto const Count = boost::accumulators::count(Accumulator);
-  if (Count > 0) {
-    auto const Density = boost::accumulators::density(Accumulator);
-    auto const Scale = float(75) / std::max_element(
-      Density.begin(), Density.end(),
-      [](auto &L, auto &R) { return L.second < R.second; }
-    )->second;
-
-    for (auto &Bin: Density) {
-      std::cout << "\n" << std::setw(4) << int(Bin.first)
-                << std::string(std::size_t(Scale * Bin.second), '-');
+  std::cout << "\33[2K\r";
+  BrlCV::LogLinearHistogram Histogram;
+  for (std::size_t I = 0; I < Histograms.size(); ++I) {
+    auto const Name = MIDILatency::outName(I) + " -> " + MIDILatency::inName(I) + ": ";
+    if (Histograms[I].count() > 0) {
+      report(std::cout, Histograms[I], Name.c_str());
+    } else {
+      std::cout << Name << "No signal" << std::endl;
+    }
+    Histogram += Histograms[I];
+  }
+  if (auto const Dropped = Latency.dropped()) {
+    std::cout << Dropped << " measurements dropped" << std::endl;
+  }
+  auto const Count = Histogram.count();
+  if (Histograms.size() > 1 && Count > 0) report(std::cout, Histogram, "This run: ");
+
+  for (auto const &Name: Previous) {
+    std::ifstream File(Name);
+    if (!File) {
+      std::cerr << "Unable to open " << Name << std::endl;
+      return EXIT_FAILURE;
+    }
+    Histogram += BrlCV::LogLinearHistogram::load(File);
+  }
+  if (!Previous.empty()) report(std::cout, Histogram, "Merged: ");
+
+  if (Output) {
+    std::ofstream File(*Output, std::ios::trunc);
+    report(File, Histogram, "# ");
+    Histogram.save(File);
+    if (!File) {
+      std::cerr << "Unable to write " << *Output << std::endl;
+      return EXIT_FAILURE;
     }
-    std::cout << std::endl;
-  } else {
-    std::cout << "\33[2K\r" << "No signal" << std::endl;
   }
 
-  return Count > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  auto const Silent = std::count_if(Histograms.begin(), Histograms.end(),
+                                    [](auto const &Latency) { return Latency.count() == 0; });
+  return Silent == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,346 @@
+#if !defined(BrlCV_MIDILATENCY_HPP)
+#define BrlCV_MIDILATENCY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <histogram.hpp>
+#include <jack.hpp>
+#include <messagebus.hpp>
+#include <module.hpp>
+#include <notifier.hpp>
+
+#include <sys/mman.h>
+
+inline void report(std::ostream &Out, BrlCV::LogLinearHistogram const &Latency,
+                   char const *Prefix = "") {
+  Out << Prefix << Latency.count() << " events:"
+      << " mean=" << std::lround(Latency.mean()) << "us"
+      << " p50=" << Latency.percentile(50) << "us"
+      << " p90=" << Latency.percentile(90) << "us"
+      << " p99=" << Latency.percentile(99) << "us"
+      << " p99.9=" << Latency.percentile(99.9) << "us"
+      << " max=" << Latency.max() << "us"
+      << std::endl;
+}
+
+class MIDILatency final : public JACK::Module {
+  struct Measurement {
+    std::uint32_t Loop;
+    std::uint32_t Frames;
+    std::uint64_t Step; // Of the ramp when the event was sent
+  };
+  using Counters = std::vector<std::atomic<std::uint32_t>>;
+  struct Loop {
+    JACK::MIDIIn In; JACK::MIDIOut Out;
+    // Distinct per loop so that crossed cables show up as bogus latencies
+    std::uint32_t const Offset;
+    std::uint64_t LastSent = 0;
+    // Per ramp step, counted in process() so a full queue is not mistaken
+    // for loss.  Sent excludes events that did not fit into this loop's
+    // port buffer, which are not the device's fault.
+    Counters Sent, Received, Reordered;
+
+    Loop(JACK::MIDIIn In, JACK::MIDIOut Out, std::uint32_t Offset, std::size_t Steps)
+    : In(std::move(In)), Out(std::move(Out)), Offset(Offset)
+    , Sent(Steps), Received(Steps), Reordered(Steps) {}
+  };
+
+public:
+  // Load steps for saturate(), in events per second and loop
+  struct Ramp {
+    double Initial = 50, Factor = 1.25;
+    std::chrono::seconds StepDuration = std::chrono::seconds(1);
+  };
+
+private:
+  JACK::Client &Owner;
+  std::string const Prefix;
+  std::uint64_t MonotonicCount = 0;
+  std::deque<Loop> Loops;
+  BrlCV::MessageQueue<Measurement> Measurements;
+  BrlCV::Notifier DataReady;
+  std::chrono::seconds const Duration;
+  // Events per loop get() waits for: one per cycle in latency mode
+  std::atomic<std::uint64_t> MaxEvents;
+  std::atomic<bool> Done = false;
+
+  unsigned int const SampleRate;
+  std::vector<double> Rates;
+  std::uint64_t StepFrames = 0;
+  double NextEvent = 0;
+  std::atomic<std::uint64_t> CurrentStep = 0;
+  // Filled by idle() when hosted, one per loop
+  std::vector<BrlCV::LogLinearHistogram> Collected;
+
+  static void increment(std::atomic<std::uint32_t> &Counter) noexcept {
+    Counter.store(Counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  // Calls send(Frame, Step) for every event the ramp schedules in this
+  // cycle and returns the position of the next one.
+  template<typename Send> double ramp(std::uint32_t FrameCount, Send send) const {
+    auto Next = NextEvent;
+    while (Next < MonotonicCount + FrameCount) {
+      auto const Step = static_cast<std::uint64_t>(Next) / StepFrames;
+      if (Step >= Rates.size()) break;
+      send(static_cast<std::uint32_t>(Next - MonotonicCount), Step);
+      Next += SampleRate / Rates[Step];
+    }
+    return Next;
+  }
+  bool send(JACK::MIDIBuffer &Buffer, Loop const &Loop, std::uint32_t Frame) {
+    MIDI::SongPositionPointer const SPP {
+      static_cast<int>((MonotonicCount + Frame + Loop.Offset) % (1 << 14))
+    };
+    auto const Data = Buffer.reserve(Frame, SPP.size());
+    if (Data.empty()) return false;
+    std::copy(SPP.begin(), SPP.end(), Data.begin());
+    return true;
+  }
+  bool receive(std::uint32_t Index, std::uint32_t FrameCount) {
+    auto &Loop = Loops[Index];
+    bool Measured = false;
+    for (auto const &Event: Loop.In.buffer(FrameCount)) {
+      auto const Message = Event.message();
+      if (Message && Message->type() == MIDI::MessageType::SongPositionPointer) {
+        auto const Received = MonotonicCount + Event.time();
+        auto const Frames = (Received - Message->value14() + Loop.Offset) % (1 << 14);
+        if (Frames > Received) continue; // Not sent by us
+        auto const SentAt = Received - Frames;
+        auto const Step = Rates.empty() ? 0 : SentAt / StepFrames;
+        if (Step < Loop.Received.size()) {
+          increment(Loop.Received[Step]);
+          if (SentAt < Loop.LastSent) increment(Loop.Reordered[Step]);
+        }
+        Measurements.send(Measurement { Index, static_cast<std::uint32_t>(Frames), Step });
+        Loop.LastSent = std::max(Loop.LastSent, SentAt);
+        Measured = true;
+      }
+    }
+    return Measured;
+  }
+
+public:
+  MIDILatency(JACK::Client &Owner, std::string_view Prefix,
+              std::size_t LoopCount, std::chrono::seconds Duration,
+              std::optional<Ramp> Stress = std::nullopt)
+  : Owner(Owner), Prefix(Prefix)
+  , Measurements(1024 * LoopCount)
+  , Duration(Duration)
+  , MaxEvents(maxEvents(Owner.bufferSize()))
+  , SampleRate(Owner.sampleRate())
+  , Collected(LoopCount)
+  {
+    Expects(LoopCount > 0 && LoopCount <= 64);
+    if (Stress) {
+      Expects(Stress->Initial > 0 && Stress->Factor > 1);
+      for (auto Rate = Stress->Initial; Rate <= SampleRate / 4; Rate *= Stress->Factor) {
+        Rates.push_back(Rate);
+      }
+      StepFrames = SampleRate * Stress->StepDuration.count();
+      Expects(!Rates.empty() && StepFrames > 0);
+    }
+    for (std::size_t I = 0; I < LoopCount; ++I) {
+      Loops.emplace_back(Owner.createMIDIIn(this->Prefix + inName(I)),
+                         Owner.createMIDIOut(this->Prefix + outName(I)),
+                         I * (1 << 14) / LoopCount, Rates.size());
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+      throw std::system_error(errno, std::generic_category());
+    }
+  }
+  std::uint64_t maxEvents(std::uint32_t FrameCount) const {
+    return std::max<std::uint64_t>(1, Owner.sampleRate() * Duration.count() / FrameCount);
+  }
+  void bufferSizeChanged(std::uint32_t FrameCount) override {
+    MaxEvents = maxEvents(FrameCount);
+  }
+  static std::string inName(std::size_t Index) {
+    return "In" + std::to_string(Index + 1);
+  }
+  static std::string outName(std::size_t Index) {
+    return "Out" + std::to_string(Index + 1);
+  }
+  std::size_t loops() const noexcept { return Loops.size(); }
+  // Measurements process() could not queue because get() or saturate()
+  // fell behind; they still count as received
+  std::uint64_t dropped() const noexcept { return Measurements.dropped(); }
+  // Patch loop Index through an external device
+  void connectLoop(std::size_t Index, std::string_view Playback, std::string_view Capture) {
+    Owner.connect(Loops.at(Index).Out, Playback);
+    Owner.connect(Capture, Loops.at(Index).In);
+  }
+
+  template<typename Frames> void run(Frames Size) {
+    auto const FrameCount = static_cast<std::uint32_t>(Size);
+    if (Rates.empty()) {
+      auto const Frame = (MonotonicCount / FrameCount) % FrameCount;
+      for (auto &Loop: Loops) {
+        auto Buffer = Loop.Out.buffer(FrameCount);
+        send(Buffer, Loop, Frame);
+      }
+    } else {
+      auto Next = NextEvent;
+      for (std::size_t I = 0; I < Loops.size(); ++I) {
+        auto Buffer = Loops[I].Out.buffer(FrameCount);
+        Next = ramp(FrameCount, [&](std::uint32_t Frame, std::uint64_t Step) {
+          if (send(Buffer, Loops[I], Frame)) increment(Loops[I].Sent[Step]);
+        });
+      }
+      NextEvent = Next;
+    }
+
+    bool Measured = false;
+    for (std::uint32_t I = 0; I < Loops.size(); ++I) Measured |= receive(I, FrameCount);
+    if (Measured) DataReady.notify();
+
+    MonotonicCount += FrameCount;
+    if (!Rates.empty()) CurrentStep.store(MonotonicCount / StepFrames);
+  }
+  void process(std::uint32_t FrameCount) override { run(FrameCount); }
+
+  // Async-signal-safe
+  void done() {
+    Done = true;
+    DataReady.notify();
+  }
+
+  // Latencies in microseconds, one histogram per loop
+  template<typename NoSignal, typename Progress>
+  std::vector<BrlCV::LogLinearHistogram> get(NoSignal noSignal, Progress progress) {
+    std::vector<BrlCV::LogLinearHistogram> Latencies(Loops.size());
+    BrlCV::LogLinearHistogram Combined;
+    auto complete = [&] {
+      return std::all_of(Latencies.begin(), Latencies.end(), [&](auto const &Latency) {
+        return Latency.count() >= MaxEvents.load();
+      });
+    };
+    auto args = [&] {
+      using std::chrono::microseconds;
+      std::uint64_t Least = Latencies.front().count();
+      std::size_t Silent = 0;
+      for (auto const &Latency: Latencies) {
+        Least = std::min(Least, Latency.count());
+        Silent += Latency.count() == 0;
+      }
+      return std::tuple(
+        microseconds(Combined.min()), microseconds(Combined.percentile(50)),
+        microseconds(Combined.percentile(99)), microseconds(Combined.max()),
+        std::min<std::uint64_t>(Least * 100 / MaxEvents.load(), 100), Silent
+      );
+    };
+
+    auto PreviousArgs = std::optional(args());
+
+    while (!Done && !complete()) {
+      auto const Seen = DataReady.sequence();
+      auto const Received = Measurements.drain([&](Measurement const &Event) {
+        auto const Microseconds = std::uint64_t(Event.Frames) * 1'000'000 / SampleRate;
+        Latencies[Event.Loop].record(Microseconds);
+        Combined.record(Microseconds);
+      });
+      if (Received == 0) {
+        noSignal();
+        PreviousArgs.reset();
+      } else {
+        decltype(PreviousArgs) Args = args();
+        if (Args != PreviousArgs) {
+          std::apply(progress, Args.value());
+          PreviousArgs = std::move(Args);
+        }
+      }
+      DataReady.waitChange(Seen, std::chrono::milliseconds(100));
+    }
+
+    Owner.deactivate();
+
+    return Latencies;
+  }
+  auto get() { return get([]{}, [](auto...){}); }
+
+  struct Load {
+    double Rate; // Events per second and loop
+    std::vector<std::uint32_t> Sent, Received, Reordered; // Per loop
+    BrlCV::LogLinearHistogram Latency; // Sampled from all loops, in microseconds
+
+    bool sustained(std::size_t Loop) const {
+      return Received[Loop] >= Sent[Loop] && Reordered[Loop] == 0;
+    }
+  };
+  // Ramp up the load until every loop drops or reorders events, calling
+  // progress(Load const &) as each step is evaluated.
+  template<typename Progress> std::vector<Load> saturate(Progress progress) {
+    Expects(!Rates.empty());
+    std::vector<Load> Loads;
+    for (auto Rate: Rates) {
+      Loads.push_back({
+        Rate, std::vector<std::uint32_t>(Loops.size()),
+        std::vector<std::uint32_t>(Loops.size()), std::vector<std::uint32_t>(Loops.size()),
+        BrlCV::LogLinearHistogram()
+      });
+    }
+    std::vector<bool> Failed(Loops.size(), false);
+    std::size_t Evaluated = 0;
+
+    auto saturated = [&] {
+      return std::find(Failed.begin(), Failed.end(), false) == Failed.end();
+    };
+
+    while (!Done && Evaluated < Loads.size() && !saturated()) {
+      auto const Seen = DataReady.sequence();
+      Measurements.drain([&](Measurement const &Event) {
+        if (Event.Step >= Loads.size()) return;
+        Loads[Event.Step].Latency.record(std::uint64_t(Event.Frames) * 1'000'000 / SampleRate);
+      });
+      // Stragglers get one whole step to arrive
+      while (Evaluated < Loads.size() && Evaluated + 2 <= CurrentStep.load() &&
+             !saturated()) {
+        auto &Load = Loads[Evaluated];
+        for (std::size_t I = 0; I < Loops.size(); ++I) {
+          Load.Sent[I] = Loops[I].Sent[Evaluated].load();
+          Load.Received[I] = Loops[I].Received[Evaluated].load();
+          Load.Reordered[I] = Loops[I].Reordered[Evaluated].load();
+          if (!Load.sustained(I)) Failed[I] = true;
+        }
+        Evaluated += 1;
+        progress(std::as_const(Load));
+      }
+      DataReady.waitChange(Seen, std::chrono::milliseconds(100));
+    }
+
+    Owner.deactivate();
+    Loads.erase(Loads.begin() + Evaluated, Loads.end());
+
+    return Loads;
+  }
+
+  // Latency mode only, when hosted with other modules
+  void idle() override {
+    Measurements.drain([&](Measurement const &Event) {
+      Collected[Event.Loop].record(std::uint64_t(Event.Frames) * 1'000'000 / SampleRate);
+    });
+  }
+  void summary(std::ostream &Out) const override {
+    for (std::size_t I = 0; I < Collected.size(); ++I) {
+      auto const Name = Prefix + outName(I) + " -> " + Prefix + inName(I) + ": ";
+      if (Collected[I].count() > 0) {
+        report(Out, Collected[I], Name.c_str());
+      } else {
+        Out << Name << "No signal" << std::endl;
+      }
+    }
+    if (auto const Lost = dropped()) Out << Lost << " measurements dropped" << std::endl;
+  }
+};
+
+#endif // BrlCV_MIDILATENCY_HPP
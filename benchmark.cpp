@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <dsp.hpp>
+#include <graph.hpp>
+#include <jack.hpp>
+#include <midi.hpp>
+
+namespace Benchmark {
+
+template<typename T> void keep(T const &Value) {
+  asm volatile("" : : "g"(&Value) : "memory");
+}
+
+// Runs Body until at least MinimumTime has passed, repeats that Repetitions
+// times and returns the fastest observed nanoseconds per call.
+template<typename Body>
+double measure(Body &&body,
+               std::chrono::nanoseconds MinimumTime = std::chrono::milliseconds(20),
+               int Repetitions = 5) {
+  using Clock = std::chrono::steady_clock;
+  std::size_t Iterations = 1;
+  while (true) {
+    auto const Start = Clock::now();
+    for (std::size_t I = 0; I < Iterations; ++I) body();
+    if (Clock::now() - Start >= MinimumTime) break;
+    Iterations *= 2;
+  }
+  auto Best = std::numeric_limits<double>::max();
+  for (int Repetition = 0; Repetition < Repetitions; ++Repetition) {
+    auto const Start = Clock::now();
+    for (std::size_t I = 0; I < Iterations; ++I) body();
+    std::chrono::duration<double, std::nano> const Elapsed = Clock::now() - Start;
+    Best = std::min(Best, Elapsed.count() / Iterations);
+  }
+  return Best;
+}
+
+// One CSV line per measurement: name, frames per block, ns per block and
+// ns per frame (or per event/item for non-audio benchmarks).  Rows ending
+// in _offline measure the offline backend, not the jack_midi_* functions.
+void report(std::string const &Name, std::uint32_t Frames, double Nanoseconds,
+            std::size_t Items) {
+  std::cout << Name << ',' << Frames << ',' << Nanoseconds << ','
+            << Nanoseconds / std::max<std::size_t>(Items, 1) << std::endl;
+}
+
+// Calls body(JACK::FixedFrames<Frames>) for the period sizes StaticClient
+// specializes, returns false for the others
+template<typename Body> bool withFixedFrames(std::uint32_t Frames, Body &&body) {
+  switch (Frames) {
+  case 32: body(JACK::FixedFrames<32>()); return true;
+  case 64: body(JACK::FixedFrames<64>()); return true;
+  case 128: body(JACK::FixedFrames<128>()); return true;
+  case 256: body(JACK::FixedFrames<256>()); return true;
+  case 512: body(JACK::FixedFrames<512>()); return true;
+  case 1024: body(JACK::FixedFrames<1024>()); return true;
+  default: return false;
+  }
+}
+
+} // namespace Benchmark
+
+class Host final : public JACK::Client {
+public:
+  JACK::MIDIOut Out;
+
+  explicit Host(std::uint32_t MaximumFrames)
+  : JACK::Client("Benchmark", JACK::Offline { 48000, MaximumFrames, {}, 0 })
+  , Out(createMIDIOut("Out"))
+  {}
+  int process(std::uint32_t) override { return 0; }
+};
+
+int main(int argc, char *argv[]) {
+  using Benchmark::keep;
+  using Benchmark::measure;
+  using Benchmark::report;
+
+  std::vector<std::uint32_t> Sizes;
+  for (int I = 1; I < argc; ++I) Sizes.push_back(std::stoul(argv[I]));
+  if (Sizes.empty()) Sizes = { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+
+  std::mt19937 Generator(0);
+  std::normal_distribution<float> Noise(0, 0.05F);
+  std::vector<float> CV(*std::max_element(Sizes.begin(), Sizes.end()));
+  for (std::size_t I = 0; I < CV.size(); ++I) {
+    CV[I] = (I % 480 < 24 ? 1.0F : 0.0F) + Noise(Generator);
+  }
+  Host Host(CV.size());
+
+  std::cout << "benchmark,frames,ns_per_block,ns_per_item" << std::endl;
+  for (auto const Frames: Sizes) {
+    gsl::span<float const> const Block(CV.data(), Frames);
+
+    BrlCV::EWMA<float> Average(0.25);
+    report("ewma", Frames, measure([&] {
+      for (auto Sample: Block) Average(Sample);
+      keep(Average);
+    }), Frames);
+
+    BrlCV::EWMA<float> Fast(0.25), Slow(0.0625);
+    float Previous = 0;
+    std::uint32_t Edges = 0;
+    report("ewma_edge_scalar", Frames, measure([&] {
+      for (auto Sample: Block) {
+        auto const Difference = Fast(Sample) - Slow(Sample);
+        Edges += Previous < 0.2F && Difference > 0.2F;
+        Previous = Difference;
+      }
+      keep(Edges);
+    }), Frames);
+
+    BrlCV::EWMAEdgeDetector Detector(0.25, 0.0625, 0.2);
+    std::array<std::uint32_t, 32> Offsets;
+    report("ewma_edge_block", Frames, measure([&] {
+      keep(Detector(Block, Offsets).size());
+    }), Frames);
+
+    std::array<float, 32> Positions;
+    report("ewma_edge_fractional", Frames, measure([&] {
+      keep(Detector(Block, Positions).size());
+    }), Frames);
+
+    BrlCV::EWMAEdgeDetectorBank Bank(8, 0.25, 0.0625, 0.2);
+    std::array<float const *, 8> Channels;
+    Channels.fill(Block.data());
+    report("ewma_edge_bank_8ch", Frames, measure([&] {
+      std::uint32_t Count = 0;
+      Bank(Channels, Frames, [&](std::size_t, float) { ++Count; });
+      keep(Count);
+    }), 8 * Frames);
+
+    Benchmark::withFixedFrames(Frames, [&](auto FrameCount) {
+      report("ewma_edge_bank_8ch_fixed", Frames, measure([&] {
+        std::uint32_t Count = 0;
+        Bank(Channels, FrameCount, [&](std::size_t, float) { ++Count; });
+        keep(Count);
+      }), 8 * Frames);
+    });
+
+    // Eight independent detectors as graph nodes, in turn and on workers
+    for (std::size_t const Workers: { std::size_t(0), std::size_t(3) }) {
+      JACK::Graph Graph(Host, Workers);
+      std::vector<BrlCV::EWMAEdgeDetector> Detectors(8, Detector);
+      std::array<std::uint32_t, 8> Counts {};
+      for (std::size_t I = 0; I < Detectors.size(); ++I) {
+        Graph.node([&, I](JACK::Cycle const &Cycle) {
+          std::array<std::uint32_t, 32> Offsets;
+          Counts[I] += Detectors[I](Block.first(Cycle.frames()), Offsets).size();
+        }, {}, {});
+      }
+      Graph.prepare();
+      report(Workers ? "graph_edge_8ch_parallel" : "graph_edge_8ch_serial", Frames,
+             measure([&] { Graph.run(Frames); keep(Counts); }), 8 * Frames);
+    }
+
+    BrlCV::MinMaxDecimator Envelope(1000);
+    report("minmax_decimate", Frames, measure([&] {
+      float Range = 0;
+      Envelope(Block, [&](float Min, float Max) { Range += Max - Min; });
+      keep(Range);
+    }), Frames);
+
+    report("fair_segmentation_construct", Frames, measure([&] {
+      BrlCV::FairSegmentation<24> Segmentation(Frames);
+      keep(Segmentation);
+    }), 1);
+
+    BrlCV::FairSegmentation<24> Segmentation;
+    report("fair_segmentation_assign", Frames, measure([&] {
+      Segmentation = Frames;
+      keep(Segmentation);
+    }), 1);
+
+    report("spp_encode", Frames, measure([&] {
+      for (std::uint32_t Frame = 0; Frame < Frames; ++Frame) {
+        MIDI::SongPositionPointer SPP(Frame % (1 << 14));
+        keep(SPP);
+      }
+    }), Frames);
+
+    std::vector<MIDI::SongPositionPointer> Encoded;
+    for (std::uint32_t Frame = 0; Frame < Frames; ++Frame) {
+      Encoded.emplace_back(Frame % (1 << 14));
+    }
+    report("spp_decode", Frames, measure([&] {
+      int Sum = 0;
+      for (auto const &SPP: Encoded) {
+        std::array<std::byte, 3> Bytes;
+        std::copy(SPP.begin(), SPP.end(), Bytes.begin());
+        Sum += MIDI::SongPositionPointer(gsl::span<std::byte>(Bytes));
+      }
+      keep(Sum);
+    }), Frames);
+
+    report("midibuffer_reserve_offline", Frames, measure([&] {
+      auto Buffer = Host.Out.buffer(Frames);
+      for (std::uint32_t Frame = 0; Frame < Frames; ++Frame) {
+        Buffer[Frame] = Encoded[Frame];
+      }
+      keep(Buffer);
+    }), Frames);
+
+    auto Buffer = Host.Out.buffer(Frames);
+    for (std::uint32_t Frame = 0; Frame < Frames; ++Frame) {
+      Buffer[Frame] = Encoded[Frame];
+    }
+    report("midibuffer_iterate_offline", Frames, measure([&] {
+      int Sum = 0;
+      for (auto const &Event: Buffer) {
+        if (Event.status() == std::byte(0XF2)) {
+          Sum += Event.time() + MIDI::SongPositionPointer(Event.bytes());
+        }
+      }
+      keep(Sum);
+    }), Frames);
+  }
+
+  return EXIT_SUCCESS;
+}
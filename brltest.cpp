@@ -1,6 +1,5 @@
 #include <chrono>
 #include <iostream>
-#include <thread>
 
 #include <brlapi.hpp>
 
@@ -18,9 +17,29 @@ int main() {
     TTY.writeText(Text);
     auto KeyCode = TTY.readKey();
     Text << " and pressed key " << KeyCode.group() << " " << KeyCode.number() << " " << KeyCode.press();
-    auto Key = BrlAPI::Driver::HandyTech::fromKeyCode(KeyCode);
     TTY.writeText(Text);
 
-    std::this_thread::sleep_for(5s);
+    // Routing keys toggle all dots of their cell
+    BrlAPI::Framebuffer Dots(TTY, Braille.displaySize());
+    BrlAPI::KeyPoller Keys;
+    Keys.add(TTY, [&Dots, Driver = Braille.driver()](BrlAPI::KeyCode const &KeyCode) {
+      cout << "Key " << int(KeyCode.group()) << " " << int(KeyCode.number())
+           << (KeyCode.press() ? " pressed" : " released") << endl;
+      if (!Driver || !KeyCode.press()) return;
+      std::visit([&](auto Driver) {
+        auto const Key = Driver.fromKeyCode(KeyCode);
+        using RoutingKey = typename decltype(Driver)::RoutingKey;
+        if (auto Routing = std::get_if<RoutingKey>(&Key); Routing && *Routing < Dots.size()) {
+          Dots[*Routing] ^= 0xFF;
+        }
+      }, *Driver);
+    });
+    auto const Deadline = std::chrono::steady_clock::now() + 5s;
+    for (auto Now = std::chrono::steady_clock::now(); Now < Deadline;
+         Now = std::chrono::steady_clock::now()) {
+      auto Until = Deadline;
+      if (!Dots.flush()) Until = std::min(Until, Dots.nextFlush());
+      Keys.poll(std::chrono::duration_cast<std::chrono::milliseconds>(Until - Now));
+    }
   }
 }
@@ -1,142 +1,100 @@
+#include <atomic>
 #include <chrono>
-#include <optional>
+#include <iostream>
+#include <stdexcept>
+#include <string>
 #include <thread>
+#include <vector>
 
-#include <boost/lockfree/spsc_queue.hpp>
+#include <module.hpp>
+#include <soundfile.hpp>
 
-#include <jack.hpp>
-#include <dsp.hpp>
+#include "cv2midiclock.hpp"
 
-class PulseTracker {
-  std::optional<std::uint32_t> FramesSinceLastPulse = std::nullopt;
-  BrlCV::FairSegmentation<24> MIDIClockFrames;
-  JACK::MIDIOut &MIDIOut;
-
-public:
-  PulseTracker(JACK::MIDIOut &MIDIOut) : MIDIOut(MIDIOut) {}
+int main(int argc, char *argv[]) {
+  auto usage = [&] {
+    std::cerr << "Usage: " << argv[0] << " [-n CHANNELS]\n"
+              << "       " << argv[0] << " IN.wav OUT.txt [IN.wav OUT.txt]..." << std::endl;
+    return EXIT_FAILURE;
+  };
 
-  class Guard {
-    PulseTracker &Tracker;
-    std::uint32_t const FrameCount;
-    std::optional<std::uint32_t> Pulse = std::nullopt;
-  public:
-    Guard(PulseTracker &Tracker, std::uint32_t FrameCount)
-    : Tracker(Tracker), FrameCount(FrameCount) {}
-    void operator()(std::uint32_t Offset) {
-      Expects(Offset < FrameCount);
-      *Pulse = Offset;
+  bool const Replay = argc >= 3 && argc % 2 == 1 && argv[1][0] != '-';
+  if (Replay) { // Replay CV recordings and write the MIDI clocks to files
+    JACK::Offline Backend;
+    if (auto Rate = BrlCV::SoundFileReader(argv[1]).sampleRate(); Rate != 0) {
+      Backend.SampleRate = Rate;
     }
-    ~Guard() {
-      auto Buffer = Tracker.MIDIOut.buffer(FrameCount);
-      Buffer.clear();
-      if (Tracker.FramesSinceLastPulse && !Pulse) {
-        *Tracker.FramesSinceLastPulse += FrameCount;
-      }
+    std::size_t const Channels = (argc - 1) / 2;
+    for (std::size_t I = 0; I < Channels; ++I) {
+      Backend.Files.emplace(EdgeDetect::inName(I), argv[1 + 2 * I]);
+      Backend.Files.emplace(EdgeDetect::outName(I), argv[2 + 2 * I]);
     }
-  };
-  [[nodiscard]] Guard operator()(std::uint32_t FrameCount) {
-    return { *this, FrameCount };
-  };
-};
-
-class EdgeDetect : public JACK::Client {
-  JACK::AudioIn CVIn;
-  JACK::MIDIOut MIDIOut;
-  BrlCV::EWMA<decltype(CVIn)::value_type> FastAverage, SlowAverage;
-  decltype(CVIn)::value_type PreviousDifference = 0;
-  std::size_t FramesSinceLastPulse = 0, FramesPerPulse = 0, FramesUntilNextMIDIClock = 0, MIDIClockPulse = 0;
-  float const Threshold;
-  BrlCV::FairSegmentation<24> MIDIClockFrameCount;
-  boost::lockfree::spsc_queue<std::size_t, boost::lockfree::capacity<8>> FPP;
-  PulseTracker CVPulse;
-
-public:
-  EdgeDetect(float Threshold = 0.2) : JACK::Client("EdgeDetect")
-  , CVIn(createAudioIn("In"))
-  , MIDIOut(createMIDIOut("Out"))
-  , FastAverage(0.25), SlowAverage(0.0625)
-  , FramesUntilNextMIDIClock(0)
-  , Threshold(Threshold)
-  , CVPulse(MIDIOut)
-  {
-    Expects(Threshold > 0);
-    activate();
-  }
-
-  void connectCVIn(std::string Name = "system:capture_1") {
-    connect(Name, CVIn);
-  }
-  void connectMIDIOut(std::string Name = "alsa_midi:Hammerfall DSP HDSP MIDI 1 (in)") {
-    connect(MIDIOut, Name);
-  }
-  std::size_t latency() const {
-    auto CaptureLatency = CVIn.latencyRange();
-    return std::get<1>(CaptureLatency);
-  }
-  int process(std::uint32_t FrameCount) override {
-    auto Pulse = CVPulse(FrameCount);
-    auto MIDIBuffer = MIDIOut.buffer(FrameCount);
-    int PulseOffset = -1;
-    std::size_t Frame = 0;
-
-    for (auto Sample : CVIn.buffer(FrameCount)) {
-      auto Difference = FastAverage(Sample) - SlowAverage(Sample);
-
-      if (PreviousDifference < Threshold && Difference > Threshold) {
-        PulseOffset = Frame;
-        FramesPerPulse = FramesSinceLastPulse;
-        FramesSinceLastPulse = 0;
-        FPP.push(FramesPerPulse);
-      }
-      PreviousDifference = Difference;
-      Frame += 1; FramesSinceLastPulse += 1;
+    JACK::ModuleClient<EdgeDetect> Client("EdgeDetect", std::move(Backend), Channels,
+                                          0.2F, BrlCV::Backpressure::Block);
+    auto &Clock = Client.module();
+    std::vector<std::vector<float>> Tempi(Channels);
+    auto collect = [&](std::size_t Channel, float BPM) { Tempi[Channel].push_back(BPM); };
+    // process() waits for room in the pulse queue, so keep draining it
+    // until the replay is done
+    std::atomic<bool> Finished { false };
+    Client.activate();
+    std::thread Replay([&] {
+      Client.wait();
+      Finished = true;
+    });
+    while (!Finished) {
+      if (Clock.waitBPM(std::chrono::milliseconds(10))) Clock.drainBPM(collect);
     }
-
-    if (FramesPerPulse) {
-      if (PulseOffset != -1) {
-        MIDIClockPulse = 0;
-        MIDIClockFrameCount = FramesPerPulse;
-        MIDIBuffer[PulseOffset] = MIDI::SystemRealTimeMessage::Clock;
-        FramesUntilNextMIDIClock = MIDIClockFrameCount[MIDIClockPulse++];
-        FramesUntilNextMIDIClock -= FrameCount - PulseOffset;
-      } else if (MIDIClockPulse < 24) {
-        if (FramesUntilNextMIDIClock < FrameCount) {
-          MIDIBuffer[FramesUntilNextMIDIClock] = MIDI::SystemRealTimeMessage::Clock;
-          FramesUntilNextMIDIClock = MIDIClockFrameCount[MIDIClockPulse++] - (FrameCount - FramesUntilNextMIDIClock);
-        } else {
-          FramesUntilNextMIDIClock -= FrameCount;
-        }
+    Replay.join();
+    Clock.drainBPM(collect);
+    for (std::size_t I = 0; I < Channels; ++I) {
+      for (auto BPM: Tempi[I]) {
+        std::cout << EdgeDetect::inName(I) << ' ' << BPM << " BPM" << std::endl;
       }
     }
+    if (auto Dropped = Clock.droppedBPM()) {
+      std::cerr << Dropped << " BPM measurements dropped" << std::endl;
+    }
 
-    return 0;
+    return EXIT_SUCCESS;
   }
 
-  std::optional<float> bpm() {
-    std::size_t FramesPerPulse;
-    if (FPP.pop(FramesPerPulse)) {
-      return static_cast<float>(sampleRate() * 60) / FramesPerPulse;
+  std::size_t Channels = 1;
+  if (argc == 3 && std::string(argv[1]) == "-n") {
+    try {
+      Channels = std::stoul(argv[2]);
+    } catch (std::logic_error const &) {
+      return usage();
     }
-    return std::nullopt;
+    if (Channels == 0) return usage();
+  } else if (argc != 1) {
+    return usage();
   }
-};
-
-using namespace std::literals::chrono_literals;
 
-int main() {
-  EdgeDetect Clock;
+  JACK::ModuleClient<EdgeDetect> Client("EdgeDetect", std::nullopt, Channels);
+  auto &Clock = Client.module();
+  Client.activate();
   std::string const Chars = "\\|/-";
   unsigned int CurrentChar = 0;
-  Clock.connectCVIn();
-  Clock.connectMIDIOut();
+  for (std::size_t I = 0; I < Channels; ++I) {
+    Clock.connectCVIn(I, "system:capture_" + std::to_string(I + 1));
+  }
+  Clock.connectMIDIOut(0, "alsa_midi:Hammerfall DSP HDSP MIDI 1 (in)");
   std::cout << Clock.latency() << std::endl;
-  while (true) {
-    if (auto BPM = Clock.bpm(); BPM) {
-      std::cout << *BPM << " BPM " << Chars[CurrentChar++] << "        \r";
-      std::flush(std::cout);
-      CurrentChar %= Chars.size();
+  // Numbers typed while running become the new edge threshold
+  std::thread([&Clock] {
+    for (float Threshold; std::cin >> Threshold;) {
+      if (Threshold > 0) Clock.setThreshold(Threshold);
     }
-    std::this_thread::sleep_for(5ms);
+  }).detach();
+  std::vector<float> Tempo(Channels);
+  while (true) {
+    Clock.waitBPM();
+    Clock.drainBPM([&](std::size_t Channel, float BPM) { Tempo[Channel] = BPM; });
+    for (std::size_t I = 0; I < Channels; ++I) std::cout << Tempo[I] << " BPM ";
+    std::cout << Chars[CurrentChar++] << "        \r";
+    std::flush(std::cout);
+    CurrentChar %= Chars.size();
   }
 
   return EXIT_SUCCESS;
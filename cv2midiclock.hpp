@@ -0,0 +1,154 @@
+#if !defined(BrlCV_CV2MIDICLOCK_HPP)
+#define BrlCV_CV2MIDICLOCK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include <dsp.hpp>
+#include <jack.hpp>
+#include <messagebus.hpp>
+#include <module.hpp>
+#include <notifier.hpp>
+
+class EdgeDetect final : public JACK::Module {
+  static constexpr std::int64_t ClocksPerPulse = 24;
+  struct Domain {
+    BrlCV::PhaseLockedLoop PLL;
+    // Index of the next clock, relative to the latest pulse
+    std::int64_t Clock = 0;
+  };
+  // From process()
+  struct Pulse {
+    std::size_t Channel;
+    double FramesPerPulse;
+  };
+  // To process()
+  struct SetThreshold {
+    float Value;
+  };
+  JACK::Client &Owner;
+  std::string const Prefix;
+  JACK::AudioInArray CVIns;
+  JACK::MIDIOutArray MIDIOuts;
+  BrlCV::EWMAEdgeDetectorBank Detector;
+  std::deque<Domain> Domains;
+  std::uint64_t Position = 0;
+  BrlCV::MessageBus<std::variant<Pulse>, std::variant<SetThreshold>> Bus;
+  BrlCV::Notifier BPMReady;
+  // Latest tempo per channel, as seen by idle()
+  std::vector<float> Tempo;
+
+public:
+  // Pulses beyond what the reader drains in time are dropped, unless
+  // Pulses is Backpressure::Block for a lossless offline replay
+  EdgeDetect(JACK::Client &Owner, std::string_view Prefix,
+             std::size_t Channels = 1, float Threshold = 0.2,
+             BrlCV::Backpressure Pulses = BrlCV::Backpressure::Drop)
+  : Owner(Owner), Prefix(Prefix)
+  , CVIns(Owner.createAudioIns(this->Prefix + "In", Channels))
+  , MIDIOuts(Owner.createMIDIOuts(this->Prefix + "Out", Channels))
+  , Detector(Channels, 0.25, 0.0625, Threshold)
+  , Domains(Channels)
+  , Bus(64 * Channels, 8, Pulses)
+  , Tempo(Channels)
+  {
+    Expects(Threshold > 0);
+  }
+  static std::string inName(std::size_t Channel) {
+    return "In" + std::to_string(Channel + 1);
+  }
+  static std::string outName(std::size_t Channel) {
+    return "Out" + std::to_string(Channel + 1);
+  }
+  std::size_t channels() const noexcept { return Domains.size(); }
+
+  void connectCVIn(std::size_t Channel, std::string Name) {
+    Owner.connect(Name, CVIns.at(Channel));
+  }
+  void connectMIDIOut(std::size_t Channel, std::string Name) {
+    Owner.connect(MIDIOuts.at(Channel), Name);
+  }
+  std::size_t latency() const {
+    auto CaptureLatency = CVIns[0].latencyRange();
+    return std::get<1>(CaptureLatency);
+  }
+  // FrameCount is std::uint32_t or JACK::FixedFrames
+  template<typename Frames> void run(Frames FrameCount) {
+    using Update = BrlCV::PhaseLockedLoop::Update;
+    auto const Size = static_cast<std::uint32_t>(FrameCount);
+    Bus.Commands.drain([this](SetThreshold const &Command) {
+      Detector.setThreshold(Command.Value);
+    });
+    bool Detected = false;
+    Detector(CVIns.gather(Size), FrameCount, [&](std::size_t Channel, float Offset) {
+      auto &Domain = Domains[Channel];
+      Detected = true;
+      switch (Domain.PLL(Position + double(Offset))) {
+      case Update::Ignored: return;
+      case Update::Acquired: Domain.Clock = 0; break;
+      case Update::Tracked: Domain.Clock -= ClocksPerPulse * Domain.PLL.advanced(); break;
+      }
+      Bus.Events.send(Pulse { Channel, Domain.PLL.period() });
+    });
+    if (Detected) BPMReady.notify();
+
+    auto const MIDIBuffers = MIDIOuts.gather(Size);
+    for (std::size_t I = 0; I < Domains.size(); ++I) {
+      auto &[PLL, Clock] = Domains[I];
+      auto &MIDIBuffer = MIDIBuffers[I];
+      // Clocks follow the predicted phase, for at most one pulse without input
+      while (PLL.locked() && Clock < ClocksPerPulse) {
+        auto const Time = PLL.anchor() + Clock * PLL.period() / ClocksPerPulse;
+        auto const Frame = std::llround(Time) - static_cast<std::int64_t>(Position);
+        if (Frame >= Size) break;
+        MIDIBuffer[std::max<std::int64_t>(Frame, 0)] = MIDI::SystemRealTimeMessage::Clock;
+        Clock += 1;
+      }
+    }
+    Position += Size;
+  }
+  void process(std::uint32_t FrameCount) override { run(FrameCount); }
+
+  // Calls tempo(Channel, BPM) for every pulse measured since the last
+  // call, returns the count
+  template<typename Handler> std::size_t drainBPM(Handler tempo) {
+    auto const Rate = Owner.sampleRate();
+    return Bus.Events.drain([&](Pulse const &Pulse) {
+      tempo(Pulse.Channel, static_cast<float>(Rate * 60 / Pulse.FramesPerPulse));
+    });
+  }
+  // Pulses lost because nobody drained them in time
+  std::uint64_t droppedBPM() const noexcept { return Bus.Events.dropped(); }
+  // Blocks until process() has measured a new pulse on any channel
+  void waitBPM() {
+    BPMReady.wait([this] { return !Bus.Events.empty(); });
+  }
+  // Returns false if there was none within Timeout
+  bool waitBPM(std::chrono::nanoseconds Timeout) {
+    return BPMReady.waitFor(Timeout, [this] { return !Bus.Events.empty(); });
+  }
+  // From any one thread but the real-time one, while the client is active
+  void setThreshold(float Value) {
+    Expects(Value > 0);
+    Bus.Commands.send(SetThreshold { Value });
+  }
+
+  void idle() override {
+    drainBPM([this](std::size_t Channel, float BPM) { Tempo[Channel] = BPM; });
+  }
+  void summary(std::ostream &Out) const override {
+    for (std::size_t I = 0; I < Tempo.size(); ++I) {
+      Out << Prefix << inName(I) << ' ' << Tempo[I] << " BPM" << std::endl;
+    }
+    if (auto const Lost = droppedBPM()) Out << Lost << " BPM measurements dropped" << std::endl;
+  }
+};
+
+#endif // BrlCV_CV2MIDICLOCK_HPP
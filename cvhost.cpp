@@ -0,0 +1,304 @@
+#include <graph.hpp>
+#include <jack.hpp>
+#include <module.hpp>
+#include <soundfile.hpp>
+
+#include "MIDILatency.hpp"
+#include "cv2midiclock.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One client running any number of modules.  Each cycle runs every module
+// once, one after the other on the JACK thread, or spread over Workers
+// additional real-time threads.  Modules share no buffers, so they are
+// independent nodes of the graph.
+class Host final : public JACK::Client {
+  struct Entry {
+    std::string Name;
+    std::unique_ptr<JACK::Module> Module;
+  };
+  std::vector<Entry> Modules;
+  std::optional<JACK::Graph> Graph;
+
+public:
+  explicit Host(std::string Name, std::optional<JACK::Offline> Backend = std::nullopt)
+  : JACK::Client(std::move(Name), std::move(Backend)) {}
+  ~Host() override { deactivate(); }
+
+  void add(std::string Name, std::unique_ptr<JACK::Module> Module) {
+    Expects(!Graph);
+    Modules.push_back({ std::move(Name), std::move(Module) });
+  }
+  void start(std::size_t Workers) {
+    Expects(!Graph);
+    Graph.emplace(*this, Workers);
+    for (auto const &Entry: Modules) {
+      Graph->node([Module = Entry.Module.get()](JACK::Cycle const &Cycle) {
+        Module->process(Cycle.frames());
+      }, {}, {});
+    }
+    Graph->prepare();
+    activate();
+  }
+
+  int process(std::uint32_t FrameCount) override {
+    Graph->run(FrameCount);
+    return 0;
+  }
+  int bufferSizeChanged(std::uint32_t FrameCount) override {
+    if (Graph) Graph->resize(FrameCount);
+    for (auto const &Entry: Modules) Entry.Module->bufferSizeChanged(FrameCount);
+    return 0;
+  }
+
+  void idle() {
+    for (auto const &Entry: Modules) Entry.Module->idle();
+  }
+  void summary(std::ostream &Out) const {
+    for (auto const &Entry: Modules) {
+      Out << '[' << Entry.Name << ']' << std::endl;
+      Entry.Module->summary(Out);
+    }
+  }
+};
+
+namespace Config {
+
+// KEY=VALUE arguments of a module line
+class Options {
+  std::map<std::string, std::string> Values;
+
+public:
+  void set(std::string const &Argument) {
+    auto const Equals = Argument.find('=');
+    if (Equals == std::string::npos || Equals == 0) {
+      throw std::runtime_error("Expected KEY=VALUE instead of " + Argument);
+    }
+    Values[Argument.substr(0, Equals)] = Argument.substr(Equals + 1);
+  }
+  // Removes Key, so that leftovers can be reported as unknown
+  template<typename T> T take(std::string const &Key, T Default) {
+    auto const Found = Values.find(Key);
+    if (Found == Values.end()) return Default;
+    std::istringstream Stream(Found->second);
+    T Value;
+    if (!(Stream >> Value) || !Stream.eof()) {
+      throw std::runtime_error("Invalid value for " + Key + ": " + Found->second);
+    }
+    Values.erase(Found);
+    return Value;
+  }
+  void finish() const {
+    if (!Values.empty()) throw std::runtime_error("Unknown option " + Values.begin()->first);
+  }
+};
+
+using Factory = std::function<
+  std::unique_ptr<JACK::Module>(JACK::Client &, std::string const &Prefix, Options &)
+>;
+
+std::map<std::string, Factory> const Types {
+  { "cv2midiclock", [](JACK::Client &Client, std::string const &Prefix, Options &Options) {
+    auto const Channels = Options.take<std::size_t>("channels", 1);
+    auto const Threshold = Options.take<float>("threshold", 0.2);
+    return std::make_unique<EdgeDetect>(Client, Prefix, Channels, Threshold);
+  } },
+  { "stats", [](JACK::Client &Client, std::string const &Prefix, Options &Options) {
+    auto const Channels = Options.take<std::size_t>("channels", 1);
+    auto const Lower = Options.take<float>("lower", -1);
+    auto const Upper = Options.take<float>("upper", 1);
+    return std::make_unique<Statistics>(Client, Prefix, Channels, Lower, Upper);
+  } },
+  { "MIDILatency", [](JACK::Client &Client, std::string const &Prefix, Options &Options) {
+    auto const Loops = Options.take<std::size_t>("loops", 1);
+    return std::make_unique<MIDILatency>(Client, Prefix, Loops, std::chrono::seconds(5));
+  } }
+};
+
+struct Module {
+  std::string Name, Type;
+  Options Arguments;
+};
+
+// Lines are one of
+//
+//   threads COUNT                  Real-time workers besides the JACK thread,
+//                                  0 (the default) runs modules in sequence
+//   module NAME TYPE [KEY=VALUE]...
+//   connect FROM TO                Port names without a client are ours
+//   replay PORT FILE               Run offline, reading or writing PORT
+//
+// Words may be double quoted, # starts a comment.
+struct File {
+  std::size_t Threads = 0;
+  std::vector<Module> Modules;
+  std::vector<std::pair<std::string, std::string>> Connections;
+  std::map<std::string, std::string> Replay;
+
+  explicit File(std::istream &Input) {
+    std::string Line;
+    for (std::size_t Number = 1; std::getline(Input, Line); ++Number) {
+      try {
+        parse(Line);
+      } catch (std::runtime_error const &Error) {
+        throw std::runtime_error("Line " + std::to_string(Number) + ": " + Error.what());
+      }
+    }
+  }
+
+private:
+  // More workers than this only add wakeups
+  static constexpr std::size_t MaximumThreads = 64;
+
+  static std::size_t threads(std::string const &Word) {
+    std::size_t Count = 0;
+    std::istringstream Stream(Word);
+    // Digits only, unsigned extraction would wrap "-1" around
+    if (Word.empty() || Word.find_first_not_of("0123456789") != std::string::npos ||
+        !(Stream >> Count) || Count > MaximumThreads) {
+      throw std::runtime_error("Thread count must be between 0 and " +
+                               std::to_string(MaximumThreads) + ": " + Word);
+    }
+    return Count;
+  }
+  void parse(std::string const &Line) {
+    std::istringstream Stream(Line);
+    std::vector<std::string> Words;
+    for (std::string Word; Stream >> std::quoted(Word);) {
+      if (!Word.empty() && Word.front() == '#') break;
+      Words.push_back(Word);
+    }
+    if (Words.empty()) return;
+    auto const &Keyword = Words.front();
+    if (Keyword == "threads" && Words.size() == 2) {
+      Threads = threads(Words[1]);
+    } else if (Keyword == "module" && Words.size() >= 3) {
+      if (Words[1].empty()) throw std::runtime_error("Empty module name");
+      if (Types.count(Words[2]) == 0) throw std::runtime_error("Unknown module type " + Words[2]);
+      for (auto const &Existing: Modules) {
+        if (Existing.Name == Words[1]) throw std::runtime_error("Duplicate module " + Words[1]);
+      }
+      Module Module { Words[1], Words[2], {} };
+      for (std::size_t I = 3; I < Words.size(); ++I) Module.Arguments.set(Words[I]);
+      Modules.push_back(std::move(Module));
+    } else if (Keyword == "connect" && Words.size() == 3) {
+      Connections.emplace_back(Words[1], Words[2]);
+    } else if (Keyword == "replay" && Words.size() == 3) {
+      Replay[Words[1]] = Words[2];
+    } else {
+      throw std::runtime_error("Invalid line starting with \"" + Keyword + '"');
+    }
+  }
+};
+
+} // namespace Config
+
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+using namespace std::literals::chrono_literals;
+
+std::atomic<bool> Done { false };
+
+void signal(int) {
+  Done = true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    std::cerr << "Usage: " << argv[0] << " CONFIG" << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::ifstream Input(argv[1]);
+  if (!Input) {
+    std::cerr << "Unable to open " << argv[1] << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  try {
+    Config::File const Setup(Input);
+    if (Setup.Modules.empty()) throw std::runtime_error("No modules");
+
+    std::optional<JACK::Offline> Backend;
+    if (!Setup.Replay.empty()) {
+      Backend.emplace();
+      // Outputs are written to files that may not exist yet
+      auto const Wave = std::find_if(Setup.Replay.begin(), Setup.Replay.end(), [](auto const &File) {
+        return File.second.size() > 4 && File.second.compare(File.second.size() - 4, 4, ".wav") == 0;
+      });
+      if (Wave != Setup.Replay.end()) {
+        if (auto Rate = BrlCV::SoundFileReader(Wave->second).sampleRate(); Rate != 0) {
+          Backend->SampleRate = Rate;
+        }
+      }
+      Backend->Files.insert(Setup.Replay.begin(), Setup.Replay.end());
+    }
+    Host Host("BrlCV", std::move(Backend));
+    for (auto Module: Setup.Modules) {
+      try {
+        Host.add(Module.Name, Config::Types.at(Module.Type)(Host, Module.Name + '.',
+                                                           Module.Arguments));
+        Module.Arguments.finish();
+      } catch (std::runtime_error const &Error) {
+        throw std::runtime_error("Module " + Module.Name + ": " + Error.what());
+      }
+    }
+
+    Host.enableTiming();
+    Host.start(Setup.Threads);
+    auto const Self = Host.name() + ':';
+    auto qualified = [&](std::string const &Port) {
+      return Port.find(':') == std::string::npos ? Self + Port : Port;
+    };
+    for (auto const &[From, To]: Setup.Connections) {
+      Host.connect(qualified(From), qualified(To));
+    }
+
+    if (Setup.Replay.empty()) {
+      std::signal(SIGINT, signal);
+      while (!Done) {
+        Host.idle();
+        Host.pollTiming();
+        std::this_thread::sleep_for(100ms);
+      }
+    } else {
+      // Replay runs faster than real time, keep draining the modules'
+      // queues while it does so that they do not fill up and drop the rest
+      std::thread Replay([&Host] {
+        Host.wait();
+        Done = true;
+      });
+      while (!Done) {
+        Host.idle();
+        Host.pollTiming();
+        std::this_thread::sleep_for(1ms);
+      }
+      Replay.join();
+    }
+    Host.deactivate();
+    Host.idle();
+
+    Host.summary(std::cout);
+    std::cout << "process(): " << Host.timing() << std::endl;
+  } catch (std::runtime_error const &Error) {
+    std::cerr << argv[1] << ": " << Error.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,237 @@
+#include <brlapi.hpp>
+#include <dsp.hpp>
+#include <jack.hpp>
+#include <notifier.hpp>
+#include <triplebuffer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+// An 8-dot cell is two columns of four dots: 1, 2, 3, 7 on the left and
+// 4, 5, 6, 8 on the right, top to bottom.  Columns are drawn as row masks
+// (bit 0 is the top row) and mapped to cell bits through these tables.
+constexpr std::array<std::uint8_t, 16> columnDots(std::array<std::uint8_t, 4> Dots) {
+  std::array<std::uint8_t, 16> Table {};
+  for (std::size_t Mask = 0; Mask < Table.size(); ++Mask) {
+    for (std::size_t Row = 0; Row < Dots.size(); ++Row) {
+      if (Mask & (1 << Row)) Table[Mask] |= Dots[Row];
+    }
+  }
+  return Table;
+}
+constexpr auto LeftDots = columnDots({{ 0x01, 0x02, 0x04, 0x40 }});
+constexpr auto RightDots = columnDots({{ 0x08, 0x10, 0x20, 0x80 }});
+
+} // namespace
+
+// Draws each input as a level meter or a scrolling scope on its share of
+// the braille display.  The envelope is decimated in process(), which
+// publishes finished cell frames through a triple buffer; the display
+// thread picks up the newest one when the display can take it.
+class CVScope final : public JACK::StaticClient<CVScope> {
+public:
+  enum class Mode { Meter, Scope };
+
+private:
+  struct Channel {
+    BrlCV::MinMaxDecimator Envelope;
+    // Row mask per dot column, a ring starting at Next in scope mode
+    std::vector<std::uint8_t> Columns;
+    std::size_t Next = 0;
+  };
+  Mode const View;
+  float const Lower, Scale;
+  std::size_t const CellsPerChannel;
+  JACK::AudioInArray Ins;
+  std::vector<Channel> Channels;
+  std::int64_t const FrameInterval;
+  std::int64_t Pending;
+  BrlCV::TripleBuffer<std::vector<std::uint8_t>> Frames;
+  BrlCV::Notifier FrameReady;
+
+  // Dot column and row of Value, clamped to the drawing area
+  std::size_t column(float Value) const {
+    auto const Count = Channels.front().Columns.size();
+    auto const Position = std::floor((Value - Lower) * Scale * Count);
+    return static_cast<std::size_t>(std::clamp<float>(Position, 0, Count - 1));
+  }
+  static std::size_t row(float Position) {
+    return 3 - static_cast<std::size_t>(std::clamp<float>(std::floor(Position * 4), 0, 3));
+  }
+
+  void scope(Channel &Channel, float Min, float Max) {
+    std::uint8_t Mask = 0;
+    if (Min <= Max) {
+      auto const Top = row((Max - Lower) * Scale), Bottom = row((Min - Lower) * Scale);
+      Mask = ((2 << Bottom) - 1) & ~((1 << Top) - 1);
+    }
+    Channel.Columns[Channel.Next] = Mask;
+    Channel.Next = (Channel.Next + 1) % Channel.Columns.size();
+  }
+  // A bar up to the maximum in the lower two rows, the min..max range in
+  // the upper two
+  void meter(Channel &Channel, float Min, float Max) {
+    std::fill(Channel.Columns.begin(), Channel.Columns.end(), 0);
+    if (Min > Max) return;
+    auto const High = column(Max);
+    for (auto I = column(Min); I <= High; ++I) Channel.Columns[I] |= 0b0011;
+    for (std::size_t I = 0; I <= High; ++I) Channel.Columns[I] |= 0b1100;
+  }
+
+  void render(std::vector<std::uint8_t> &Cells) const {
+    std::fill(Cells.begin(), Cells.end(), 0);
+    for (std::size_t I = 0; I < Channels.size(); ++I) {
+      auto const &Columns = Channels[I].Columns;
+      auto const Count = Columns.size();
+      auto const Start = View == Mode::Scope ? Channels[I].Next : 0;
+      auto *const Cell = &Cells[I * CellsPerChannel];
+      for (std::size_t J = 0; J < Count; J += 2) {
+        Cell[J / 2] = LeftDots[Columns[(Start + J) % Count]]
+                    | RightDots[Columns[(Start + J + 1) % Count]];
+      }
+    }
+  }
+
+public:
+  // Span is the time shown across a scope, FrameInterval the time between
+  // published frames (and the meter window)
+  CVScope(std::size_t ChannelCount, std::size_t Cells, Mode View,
+          float Lower, float Upper,
+          std::chrono::duration<double> Span,
+          std::chrono::duration<double> FrameInterval)
+  : JACK::StaticClient<CVScope>("CVScope")
+  , View(View), Lower(Lower), Scale(1 / (Upper - Lower))
+  , CellsPerChannel(ChannelCount > 0 ? Cells / ChannelCount : 0)
+  , Ins(createAudioIns("In", ChannelCount))
+  , FrameInterval(std::max<std::int64_t>(1, std::llround(FrameInterval.count() * sampleRate())))
+  , Pending(this->FrameInterval)
+  , Frames(std::vector<std::uint8_t>(Cells))
+  {
+    Expects(Lower < Upper);
+    Expects(CellsPerChannel > 0);
+    auto const ColumnCount = 2 * CellsPerChannel;
+    auto const Factor = View == Mode::Scope
+      ? std::max<std::int64_t>(1, std::llround(Span.count() * sampleRate() / ColumnCount))
+      : this->FrameInterval;
+    Channels.reserve(ChannelCount);
+    for (std::size_t I = 0; I < ChannelCount; ++I) {
+      Channels.push_back({ BrlCV::MinMaxDecimator(Factor),
+                           std::vector<std::uint8_t>(ColumnCount) });
+    }
+    activate();
+  }
+  ~CVScope() override { deactivate(); }
+
+  static std::string inName(std::size_t Channel) {
+    return "In" + std::to_string(Channel + 1);
+  }
+  void connectIn(std::size_t Channel, std::string Name) {
+    connect(Name, Ins.at(Channel));
+  }
+
+  int process(std::uint32_t FrameCount) override {
+    Ins.gather(FrameCount);
+    for (std::size_t I = 0; I < Ins.size(); ++I) {
+      auto &Channel = Channels[I];
+      Channel.Envelope(Ins.buffer(I), [&](float Min, float Max) {
+        if (View == Mode::Scope) {
+          scope(Channel, Min, Max);
+        } else {
+          meter(Channel, Min, Max);
+        }
+      });
+    }
+    Pending -= FrameCount;
+    if (Pending <= 0) {
+      render(Frames.back());
+      Frames.publish();
+      FrameReady.notify();
+      Pending += FrameInterval;
+    }
+    return 0;
+  }
+
+  // Display thread side
+  bool waitFrame(std::chrono::nanoseconds Timeout) {
+    return FrameReady.waitFor(Timeout, [this] { return Frames.fresh(); });
+  }
+  // Newest frame since the last call, nullptr if there is none
+  std::vector<std::uint8_t> const *frame() {
+    return Frames.update() ? &Frames.front() : nullptr;
+  }
+};
+
+#include <csignal>
+#include <iostream>
+#include <thread>
+
+using namespace std::literals::chrono_literals;
+
+std::atomic<bool> Done { false };
+
+void signal(int) {
+  Done = true;
+}
+
+int main(int argc, char *argv[]) {
+  std::size_t Channels = 1;
+  auto View = CVScope::Mode::Scope;
+  float Lower = -1, Upper = 1;
+  std::chrono::duration<double> Span = 2s;
+  std::chrono::milliseconds Interval = 40ms;
+  for (int I = 1; I < argc; ++I) {
+    std::string const Argument = argv[I];
+    if (Argument == "-n" && I + 1 < argc) {
+      Channels = std::stoul(argv[++I]);
+    } else if (Argument == "-m") {
+      View = CVScope::Mode::Meter;
+    } else if (Argument == "-r" && I + 2 < argc) {
+      Lower = std::stof(argv[++I]);
+      Upper = std::stof(argv[++I]);
+    } else if (Argument == "-s" && I + 1 < argc) {
+      Span = std::chrono::duration<double>(std::stod(argv[++I]));
+    } else if (Argument == "-i" && I + 1 < argc) {
+      Interval = std::chrono::milliseconds(std::stoul(argv[++I]));
+    } else {
+      std::cerr << "Usage: " << argv[0]
+                << " [-n CHANNELS] [-m] [-r LOW HIGH] [-s SECONDS] [-i MILLISECONDS]"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  BrlAPI::Connection Braille;
+  auto const Size = Braille.displaySize();
+  auto TTY = Braille.tty(1, false);
+  BrlAPI::Framebuffer Dots(TTY, Size, Interval);
+  if (Channels == 0 || Channels > Dots.size()) {
+    std::cerr << "Between 1 and " << Dots.size() << " channels fit on a "
+              << Size << " display" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  CVScope Scope(Channels, Dots.size(), View, Lower, Upper, Span, Interval);
+  for (std::size_t I = 0; I < Channels; ++I) {
+    Scope.connectIn(I, "system:capture_" + std::to_string(I + 1));
+  }
+  std::signal(SIGINT, signal);
+
+  // Frames arriving while the display is busy replace each other, so every
+  // flush shows the newest one
+  while (!Done) {
+    Scope.waitFrame(Dots.dirty() ? 0ms : 100ms);
+    if (auto const Frame = Scope.frame()) {
+      std::copy(Frame->begin(), Frame->end(), Dots.cells().begin());
+    }
+    if (!Dots.flush()) std::this_thread::sleep_until(Dots.nextFlush());
+  }
+
+  return EXIT_SUCCESS;
+}
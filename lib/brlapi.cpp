@@ -1,11 +1,22 @@
 #include "brlapi.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
 #include <brlapi.h>
 #define PACKED
+#include <brltty/brldefs-bm.h>
+#include <brltty/brldefs-fs.h>
 #include <brltty/brldefs-ht.h>
 #undef PACKED
 
 #include <netdb.h>
+#include <sys/epoll.h>
+#include <unistd.h>
 
 namespace {
   
@@ -70,34 +81,114 @@ std::ostream &operator<<(std::ostream &Out, DisplaySize const &Size) {
   
 } // namespace BrlAPI
 
-namespace BrlAPI::Driver {
+namespace {
+
+// Key codes of one driver indexed by group and number.  Navigation keys map
+// to their enumerator, routing groups map each number to itself.
+template<std::size_t Groups> class KeyTable {
+public:
+  enum class Kind : std::uint8_t { Unknown, Navigation, Routing };
+  struct Entry {
+    Kind Type = Kind::Unknown;
+    std::uint8_t Value = 0;
+  };
+
+private:
+  std::array<std::array<Entry, 256>, Groups> Entries {};
+
+public:
+  template<typename NavigationKey>
+  constexpr void navigation(std::size_t Group, std::size_t Number, NavigationKey Key) {
+    Entries[Group][Number] = { Kind::Navigation, static_cast<std::uint8_t>(Key) };
+  }
+  constexpr void routing(std::size_t Group) {
+    for (std::size_t Number = 0; Number < 256; ++Number) {
+      Entries[Group][Number] = { Kind::Routing, static_cast<std::uint8_t>(Number) };
+    }
+  }
 
-HandyTech::Key HandyTech::fromKeyCode(BrlAPI::KeyCode const &Key) {
-  switch (static_cast<HT_KeyGroup>(Key.group())) {
-  case HT_GRP_NavigationKeys:
-    switch (static_cast<HT_NavigationKey>(Key.number())) {
-    case HT_KEY_B1: return NavigationKey::B1;
-    case HT_KEY_B2: return NavigationKey::B2;
-    case HT_KEY_B3: return NavigationKey::B3;
-    case HT_KEY_B4: return NavigationKey::B4;
-    case HT_KEY_B5: return NavigationKey::B5;
-    case HT_KEY_B6: return NavigationKey::B6;
-    case HT_KEY_B7: return NavigationKey::B7;
-    case HT_KEY_B8: return NavigationKey::B8;
-    case HT_KEY_Space: return NavigationKey::LeftSpace;
-    case HT_KEY_SpaceRight: return NavigationKey::RightSpace;
-    default: throw std::runtime_error("Unknown HandyTech navigation key " + std::to_string(Key.number()));
+  template<typename Driver>
+  typename Driver::Key operator()(BrlAPI::KeyCode const &Code) const noexcept {
+    if (Code.group() >= Groups) return BrlAPI::Driver::UnknownKey { Code };
+    auto const &Found = Entries[Code.group()][Code.number()];
+    switch (Found.Type) {
+    case Kind::Navigation:
+      return static_cast<typename Driver::NavigationKey>(Found.Value);
+    case Kind::Routing: return typename Driver::RoutingKey(Found.Value);
+    default: return BrlAPI::Driver::UnknownKey { Code };
     }
-  case HT_GRP_RoutingKeys: return RoutingKey(Key.number());
-  default: throw std::runtime_error("Unknown HandyTech key group");
   }
+};
+
+constexpr auto HandyTechKeys = [] {
+  using Key = BrlAPI::Driver::HandyTech::NavigationKey;
+  KeyTable<HT_GRP_RoutingKeys + 1> Table;
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_B1, Key::B1);
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_B2, Key::B2);
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_B3, Key::B3);
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_B4, Key::B4);
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_B5, Key::B5);
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_B6, Key::B6);
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_B7, Key::B7);
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_B8, Key::B8);
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_Space, Key::LeftSpace);
+  Table.navigation(HT_GRP_NavigationKeys, HT_KEY_SpaceRight, Key::RightSpace);
+  Table.routing(HT_GRP_RoutingKeys);
+  return Table;
+}();
+
+constexpr auto BaumKeys = [] {
+  using Key = BrlAPI::Driver::Baum::NavigationKey;
+  KeyTable<BM_GRP_RoutingKeys1 + 1> Table;
+  for (std::size_t I = 0; I < 6; ++I) {
+    Table.navigation(BM_GRP_NavigationKeys, BM_KEY_DISPLAY + I,
+                     static_cast<Key>(static_cast<std::size_t>(Key::Display1) + I));
+  }
+  for (std::size_t I = 0; I < 7; ++I) {
+    Table.navigation(BM_GRP_NavigationKeys, BM_KEY_COMMAND + I,
+                     static_cast<Key>(static_cast<std::size_t>(Key::Command1) + I));
+  }
+  Table.routing(BM_GRP_RoutingKeys1);
+  return Table;
+}();
+
+constexpr auto FreedomScientificKeys = [] {
+  using Key = BrlAPI::Driver::FreedomScientific::NavigationKey;
+  KeyTable<FS_GRP_RoutingKeys + 1> Table;
+  for (std::size_t I = 0; I < 8; ++I) {
+    Table.navigation(FS_GRP_NavigationKeys, FS_KEY_Dot1 + I,
+                     static_cast<Key>(static_cast<std::size_t>(Key::Dot1) + I));
+  }
+  Table.navigation(FS_GRP_NavigationKeys, FS_KEY_Space, Key::Space);
+  Table.navigation(FS_GRP_NavigationKeys, FS_KEY_LeftAdvance, Key::LeftAdvance);
+  Table.navigation(FS_GRP_NavigationKeys, FS_KEY_RightAdvance, Key::RightAdvance);
+  Table.routing(FS_GRP_RoutingKeys);
+  return Table;
+}();
+
+} // namespace
+
+namespace BrlAPI::Driver {
+
+HandyTech::Key HandyTech::fromKeyCode(KeyCode const &Code) noexcept {
+  return HandyTechKeys.operator()<HandyTech>(Code);
 }
 
+Baum::Key Baum::fromKeyCode(KeyCode const &Code) noexcept {
+  return BaumKeys.operator()<Baum>(Code);
 }
 
+FreedomScientific::Key FreedomScientific::fromKeyCode(KeyCode const &Code) noexcept {
+  return FreedomScientificKeys.operator()<FreedomScientific>(Code);
+}
+
+} // namespace BrlAPI::Driver
+
 class BrlAPI::Connection::Implementation {
   std::unique_ptr<std::byte[]> HandleStorage;
 public:
+  int FileDescriptor = -1;
+
   Implementation() : HandleStorage(new std::byte[brlapi_getHandleSize()]) {}
   brlapi_handle_t *handle() const {
     return reinterpret_cast<brlapi_handle_t *>(HandleStorage.get());
@@ -108,12 +199,30 @@ BrlAPI::TTY::~TTY() {
   brlapi__leaveTtyMode(Conn.BrlAPI->handle());
 }
 
-void BrlAPI::TTY::writeText(std::string Text) {
+void BrlAPI::TTY::writeText(std::string const &Text) {
   if (brlapi__writeText(Conn.BrlAPI->handle(), -1, Text.c_str()) == -1) {
     throwSystemError();
   }
 }
 
+void BrlAPI::TTY::writeDots(unsigned int Begin, gsl::span<std::uint8_t const> Dots) {
+  if (Dots.empty()) return;
+  // The text is irrelevant as andMask clears whatever it translates to
+  std::vector<char> Text(Dots.size(), ' ');
+  std::vector<unsigned char> Clear(Dots.size(), 0);
+  brlapi_writeArguments_t Arguments = BRLAPI_WRITEARGUMENTS_INITIALIZER;
+  Arguments.regionBegin = Begin + 1;
+  Arguments.regionSize = static_cast<int>(Dots.size());
+  Arguments.text = Text.data();
+  Arguments.textSize = static_cast<int>(Text.size());
+  Arguments.andMask = Clear.data();
+  Arguments.orMask = const_cast<unsigned char *>(Dots.data());
+  Arguments.cursor = BRLAPI_CURSOR_OFF;
+  if (brlapi__write(Conn.BrlAPI->handle(), &Arguments) == -1) {
+    throwSystemError();
+  }
+}
+
 BrlAPI::KeyCode BrlAPI::TTY::readKey() const {
   brlapi_keyCode_t Key;
   if (brlapi__readKey(Conn.BrlAPI->handle(), 1, &Key) == -1) {
@@ -134,10 +243,28 @@ bool BrlAPI::TTY::readKey(KeyCode &KeyCode) const {
   return Result == 1;
 }
 
+int BrlAPI::TTY::fileDescriptor() const noexcept {
+  return Conn.fileDescriptor();
+}
+
+std::size_t BrlAPI::TTY::readKeys(gsl::span<KeyCode> Keys) const {
+  std::size_t Count = 0;
+  while (Count < std::size_t(Keys.size())) {
+    brlapi_keyCode_t Key;
+    auto const Result = brlapi__readKey(Conn.BrlAPI->handle(), 0, &Key);
+    if (Result == -1) {
+      throwSystemError();
+    }
+    if (Result == 0) break;
+    Keys[Count++] = KeyCode(Key);
+  }
+  return Count;
+}
+
 BrlAPI::Connection::Connection() : BrlAPI(std::make_unique<Implementation>()) {
   brlapi_connectionSettings_t Settings = BRLAPI_SETTINGS_INITIALIZER;
-  auto FileDescriptor = brlapi__openConnection(BrlAPI->handle(), &Settings, &Settings);
-  if (FileDescriptor == -1) {
+  BrlAPI->FileDescriptor = brlapi__openConnection(BrlAPI->handle(), &Settings, &Settings);
+  if (BrlAPI->FileDescriptor == -1) {
     throwSystemError();
   }
 }
@@ -155,6 +282,18 @@ std::string BrlAPI::Connection::driverName() const {
   return { Name, strlen(Name) };
 }
 
+int BrlAPI::Connection::fileDescriptor() const noexcept {
+  return BrlAPI->FileDescriptor;
+}
+
+std::optional<BrlAPI::Connection::Driver> BrlAPI::Connection::driver() const {
+  auto const Name = driverName();
+  if (Name == "HandyTech") return BrlAPI::Driver::HandyTech();
+  if (Name == "Baum") return BrlAPI::Driver::Baum();
+  if (Name == "FreedomScientific") return BrlAPI::Driver::FreedomScientific();
+  return std::nullopt;
+}
+
 BrlAPI::DisplaySize BrlAPI::Connection::displaySize() const {
   DisplaySize Size;
   brlapi__getDisplaySize(BrlAPI->handle(), &Size.X, &Size.Y);
@@ -162,7 +301,8 @@ BrlAPI::DisplaySize BrlAPI::Connection::displaySize() const {
 }
 
 BrlAPI::TTY BrlAPI::Connection::tty(int TTY, bool Raw) {
-  auto Number = brlapi__enterTtyMode(BrlAPI->handle(), TTY, Raw? "HandyTech" : "");
+  auto Number = brlapi__enterTtyMode(BrlAPI->handle(), TTY,
+                                     Raw? driverName().c_str() : "");
   if (Number == -1) {
     throwSystemError();
   }
@@ -180,3 +320,89 @@ BrlAPI::TTY BrlAPI::Connection::tty(int TTY, bool Raw) {
   return { *this, Number };
 }
 
+
+BrlAPI::KeyPoller::KeyPoller() : EventFileDescriptor(epoll_create1(EPOLL_CLOEXEC)) {
+  if (EventFileDescriptor == -1) {
+    throw std::system_error(errno, std::generic_category());
+  }
+}
+
+BrlAPI::KeyPoller::~KeyPoller() {
+  close(EventFileDescriptor);
+}
+
+void BrlAPI::KeyPoller::add(TTY const &Terminal, std::function<void(KeyCode const &)> Handler) {
+  Expects(Handler);
+  Entries.push_back(std::make_unique<Entry>(Entry { Terminal, std::move(Handler) }));
+  epoll_event Event {};
+  Event.events = EPOLLIN;
+  Event.data.ptr = Entries.back().get();
+  if (epoll_ctl(EventFileDescriptor, EPOLL_CTL_ADD, Terminal.fileDescriptor(), &Event) == -1) {
+    Entries.pop_back();
+    throw std::system_error(errno, std::generic_category());
+  }
+}
+
+void BrlAPI::KeyPoller::remove(TTY const &Terminal) {
+  auto const Found = std::find_if(Entries.begin(), Entries.end(), [&](auto const &Watched) {
+    return &Watched->Terminal == &Terminal;
+  });
+  if (Found == Entries.end()) return;
+  epoll_ctl(EventFileDescriptor, EPOLL_CTL_DEL, Terminal.fileDescriptor(), nullptr);
+  Entries.erase(Found);
+}
+
+std::size_t BrlAPI::KeyPoller::poll(std::chrono::milliseconds Timeout) {
+  std::array<epoll_event, 16> Events;
+  auto const Ready = epoll_wait(EventFileDescriptor, Events.data(), Events.size(),
+                                Timeout.count() < 0 ? -1 : static_cast<int>(Timeout.count()));
+  if (Ready == -1) {
+    if (errno == EINTR) return 0;
+    throw std::system_error(errno, std::generic_category());
+  }
+  std::size_t Count = 0;
+  for (int I = 0; I < Ready; ++I) {
+    auto &Watched = *static_cast<Entry *>(Events[I].data.ptr);
+    Count += Watched.Terminal.dispatchKeys(Watched.Handler);
+  }
+  return Count;
+}
+
+BrlAPI::Framebuffer::Framebuffer(TTY &Terminal, DisplaySize Size,
+                                 std::chrono::milliseconds Interval)
+: Terminal(Terminal), Cells(Size.X * Size.Y), Sent(Cells.size()), Interval(Interval)
+{
+  Expects(!Cells.empty());
+}
+
+bool BrlAPI::Framebuffer::flush() {
+  if (!dirty()) return true;
+  auto const Now = std::chrono::steady_clock::now();
+  if (SentValid && Now < nextFlush()) return false;
+
+  // Runs separated by fewer unchanged cells than this go out as one write,
+  // as resending them is cheaper than another packet
+  constexpr std::size_t MergeGap = 4;
+  auto const Size = Cells.size();
+  std::size_t Begin = 0;
+  while (Begin < Size) {
+    while (Begin < Size && SentValid && Cells[Begin] == Sent[Begin]) ++Begin;
+    if (Begin == Size) break;
+    auto End = Begin + 1, Unchanged = std::size_t(0);
+    for (auto I = End; I < Size && Unchanged < MergeGap; ++I) {
+      if (SentValid && Cells[I] == Sent[I]) {
+        ++Unchanged;
+      } else {
+        End = I + 1;
+        Unchanged = 0;
+      }
+    }
+    Terminal.writeDots(Begin, gsl::span<std::uint8_t const>(&Cells[Begin], End - Begin));
+    Begin = End;
+  }
+  Sent = Cells;
+  SentValid = true;
+  LastFlush = Now;
+
+  return true;
+}
@@ -1,9 +1,18 @@
 #if !defined(BrlCV_BrlAPI_HPP)
 #define BrlCV_BrlAPI_HPP
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <ostream>
 #include <sstream>
+#include <string>
 #include <variant>
+#include <vector>
 
 #include <experimental/propagate_const>
 
@@ -33,6 +42,7 @@ class KeyCode {
   bool Press;
 
 public:
+  KeyCode() noexcept : KeyCode(0, 0, false) {}
   KeyCode(std::uint8_t Group, std::uint8_t Number, bool Press) noexcept
   : Group(Group), Number(Number), Press(Press) {}
   explicit KeyCode(std::uint64_t Code) noexcept
@@ -45,16 +55,45 @@ public:
   auto press() const noexcept { return Press; }
 };
 
+// Typed keys of the drivers whose raw key codes we understand.  Decoding
+// is a lookup in a table generated at compile time; codes a driver does
+// not define come back as UnknownKey instead of throwing.
 namespace Driver {
 
+struct UnknownKey {
+  KeyCode Code;
+};
+
 class HandyTech {
 public:
   enum class NavigationKey : std::uint8_t {
     B1, B2, B3, B4, B5, B6, B7, B8, LeftSpace, RightSpace
   };
   BOOST_STRONG_TYPEDEF(std::uint8_t, RoutingKey)
-  using Key = std::variant<NavigationKey, RoutingKey>;
-  static Key fromKeyCode(KeyCode const &);
+  using Key = std::variant<UnknownKey, NavigationKey, RoutingKey>;
+  static Key fromKeyCode(KeyCode const &) noexcept;
+};
+
+class Baum {
+public:
+  enum class NavigationKey : std::uint8_t {
+    Display1, Display2, Display3, Display4, Display5, Display6,
+    Command1, Command2, Command3, Command4, Command5, Command6, Command7
+  };
+  BOOST_STRONG_TYPEDEF(std::uint8_t, RoutingKey)
+  using Key = std::variant<UnknownKey, NavigationKey, RoutingKey>;
+  static Key fromKeyCode(KeyCode const &) noexcept;
+};
+
+class FreedomScientific {
+public:
+  enum class NavigationKey : std::uint8_t {
+    Dot1, Dot2, Dot3, Dot4, Dot5, Dot6, Dot7, Dot8,
+    Space, LeftAdvance, RightAdvance
+  };
+  BOOST_STRONG_TYPEDEF(std::uint8_t, RoutingKey)
+  using Key = std::variant<UnknownKey, NavigationKey, RoutingKey>;
+  static Key fromKeyCode(KeyCode const &) noexcept;
 };
 
 } // namespace Driver
@@ -77,11 +116,29 @@ public:
 
   int number() const noexcept { return Number; }
 
-  void writeText(std::string);
+  void writeText(std::string const &);
   void writeText(std::stringstream const &Stream) { writeText(Stream.str()); }
+  // Raw dot patterns (bit 0 is dot 1) for the cells starting at Begin
+  void writeDots(unsigned int Begin, gsl::span<std::uint8_t const> Dots);
 
   KeyCode readKey() const;
   bool readKey(KeyCode &) const;
+
+  // Readable when keys are pending, for poll/epoll based event loops
+  int fileDescriptor() const noexcept;
+  // Reads pending keys without blocking until Keys is full, returns the count
+  std::size_t readKeys(gsl::span<KeyCode> Keys) const;
+  // Calls handler(KeyCode const &) for every pending key, returns the count
+  template<typename Handler> std::size_t dispatchKeys(Handler &&handler) const {
+    std::array<KeyCode, 32> Keys;
+    std::size_t Total = 0, Count;
+    do {
+      Count = readKeys(Keys);
+      for (std::size_t I = 0; I < Count; ++I) handler(Keys[I]);
+      Total += Count;
+    } while (Count == Keys.size());
+    return Total;
+  }
 };
 
 class Connection {
@@ -101,10 +158,72 @@ public:
 
   std::string driverName() const;
   DisplaySize displaySize() const;
+  int fileDescriptor() const noexcept;
+
+  // Raw mode delivers the key codes of the display's driver
+  TTY tty(int, bool Raw);
+
+  using Driver = std::variant<Driver::HandyTech, Driver::Baum, Driver::FreedomScientific>;
+  // Selected by driverName(), empty if we cannot decode its keys
+  std::optional<Driver> driver() const;
+};
+
+// Dot pattern framebuffer for a TTY.  flush() only sends the cells changed
+// since the last flush, and at most once per Interval so that frames are
+// coalesced to what the display can sustain.
+class Framebuffer {
+  TTY &Terminal;
+  std::vector<std::uint8_t> Cells, Sent;
+  bool SentValid = false;
+  std::chrono::steady_clock::duration const Interval;
+  std::chrono::steady_clock::time_point LastFlush;
+
+public:
+  Framebuffer(TTY &, DisplaySize,
+              std::chrono::milliseconds Interval = std::chrono::milliseconds(40));
+
+  std::size_t size() const noexcept { return Cells.size(); }
+  std::uint8_t &operator[](std::size_t Index) { return Cells[Index]; }
+  std::uint8_t operator[](std::size_t Index) const { return Cells[Index]; }
+  gsl::span<std::uint8_t> cells() noexcept { return Cells; }
+  void clear() { std::fill(Cells.begin(), Cells.end(), 0); }
+
+  bool dirty() const { return !SentValid || Cells != Sent; }
+  // Earliest time the next flush() may write
+  std::chrono::steady_clock::time_point nextFlush() const noexcept {
+    return LastFlush + Interval;
+  }
+  // Sends the changed cells unless the last write was less than Interval
+  // ago.  Returns true when the display is up to date.
+  bool flush();
+  // Resends everything on the next flush(), e.g. after another client wrote
+  void invalidate() noexcept { SentValid = false; }
+};
+
+// Dispatches key input of any number of TTYs from one thread.  Each TTY
+// needs its own Connection, as they are told apart by file descriptor, and
+// must stay in place until it is removed.
+class KeyPoller {
+  struct Entry {
+    TTY const &Terminal;
+    std::function<void(KeyCode const &)> Handler;
+  };
+  int EventFileDescriptor;
+  std::vector<std::unique_ptr<Entry>> Entries;
+
+public:
+  KeyPoller();
+  ~KeyPoller();
+
+  KeyPoller(KeyPoller const &) = delete;
+  KeyPoller &operator=(KeyPoller const &) = delete;
 
-  TTY tty(int, bool);
+  void add(TTY const &, std::function<void(KeyCode const &)>);
+  void remove(TTY const &);
 
-  using Driver = std::variant<Driver::HandyTech>;
+  // Waits up to Timeout (forever if negative) for input and dispatches all
+  // pending keys, returns the number of keys dispatched.
+  std::size_t poll(std::chrono::milliseconds Timeout = std::chrono::milliseconds(-1));
 };
 
 } // namespace BrlAPI
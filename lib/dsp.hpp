@@ -1,9 +1,24 @@
 #if !defined(BrlCV_DSP_HPP)
 #define BrlCV_DSP_HPP
 
+#include <algorithm>
+#include <array>
 #include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
 #include <gsl/gsl>
 
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define BrlCV_SIMD_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define BrlCV_SIMD_SSE2
+#endif
+
 namespace BrlCV {
 
 // https://en.wikipedia.org/wiki/Moving_average#Exponential_moving_average
@@ -27,6 +42,612 @@ public:
 
 template<typename T> using EWMA = ExponentiallyWeightedMovingAverage<T>;
 
+// Vector register abstraction for the block kernels below.  Lanes == 1 is the
+// portable scalar fallback.
+namespace SIMD {
+
+#if defined(BrlCV_SIMD_AVX2)
+struct Float {
+  static constexpr std::size_t Lanes = 8;
+  __m256 Value;
+
+  static Float load(float const *P) { return { _mm256_loadu_ps(P) }; }
+  static Float broadcast(float V) { return { _mm256_set1_ps(V) }; }
+  static Float broadcast(float const *P) { return { _mm256_broadcast_ss(P) }; }
+  friend Float fma(Float A, Float B, Float C) {
+    return { _mm256_fmadd_ps(A.Value, B.Value, C.Value) };
+  }
+  friend Float operator-(Float A, Float B) { return { _mm256_sub_ps(A.Value, B.Value) }; }
+  // Broadcast of the last lane
+  Float last() const {
+    return { _mm256_permutevar8x32_ps(Value, _mm256_set1_epi32(7)) };
+  }
+  float first() const { return _mm256_cvtss_f32(Value); }
+  friend unsigned int operator<(Float A, Float B) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(A.Value, B.Value, _CMP_LT_OQ));
+  }
+  friend unsigned int operator>(Float A, Float B) {
+    return _mm256_movemask_ps(_mm256_cmp_ps(A.Value, B.Value, _CMP_GT_OQ));
+  }
+  friend Float operator+(Float A, Float B) { return { _mm256_add_ps(A.Value, B.Value) }; }
+  friend Float operator*(Float A, Float B) { return { _mm256_mul_ps(A.Value, B.Value) }; }
+  friend Float minimum(Float A, Float B) { return { _mm256_min_ps(A.Value, B.Value) }; }
+  friend Float maximum(Float A, Float B) { return { _mm256_max_ps(A.Value, B.Value) }; }
+  std::array<float, Lanes> lanes() const {
+    std::array<float, Lanes> Result;
+    _mm256_storeu_ps(Result.data(), Value);
+    return Result;
+  }
+};
+
+inline void transpose(std::array<Float, Float::Lanes> &Rows) {
+  auto const &R = Rows;
+  auto const T0 = _mm256_unpacklo_ps(R[0].Value, R[1].Value);
+  auto const T1 = _mm256_unpackhi_ps(R[0].Value, R[1].Value);
+  auto const T2 = _mm256_unpacklo_ps(R[2].Value, R[3].Value);
+  auto const T3 = _mm256_unpackhi_ps(R[2].Value, R[3].Value);
+  auto const T4 = _mm256_unpacklo_ps(R[4].Value, R[5].Value);
+  auto const T5 = _mm256_unpackhi_ps(R[4].Value, R[5].Value);
+  auto const T6 = _mm256_unpacklo_ps(R[6].Value, R[7].Value);
+  auto const T7 = _mm256_unpackhi_ps(R[6].Value, R[7].Value);
+  auto const S0 = _mm256_shuffle_ps(T0, T2, _MM_SHUFFLE(1, 0, 1, 0));
+  auto const S1 = _mm256_shuffle_ps(T0, T2, _MM_SHUFFLE(3, 2, 3, 2));
+  auto const S2 = _mm256_shuffle_ps(T1, T3, _MM_SHUFFLE(1, 0, 1, 0));
+  auto const S3 = _mm256_shuffle_ps(T1, T3, _MM_SHUFFLE(3, 2, 3, 2));
+  auto const S4 = _mm256_shuffle_ps(T4, T6, _MM_SHUFFLE(1, 0, 1, 0));
+  auto const S5 = _mm256_shuffle_ps(T4, T6, _MM_SHUFFLE(3, 2, 3, 2));
+  auto const S6 = _mm256_shuffle_ps(T5, T7, _MM_SHUFFLE(1, 0, 1, 0));
+  auto const S7 = _mm256_shuffle_ps(T5, T7, _MM_SHUFFLE(3, 2, 3, 2));
+  Rows = {{
+    { _mm256_permute2f128_ps(S0, S4, 0X20) }, { _mm256_permute2f128_ps(S1, S5, 0X20) },
+    { _mm256_permute2f128_ps(S2, S6, 0X20) }, { _mm256_permute2f128_ps(S3, S7, 0X20) },
+    { _mm256_permute2f128_ps(S0, S4, 0X31) }, { _mm256_permute2f128_ps(S1, S5, 0X31) },
+    { _mm256_permute2f128_ps(S2, S6, 0X31) }, { _mm256_permute2f128_ps(S3, S7, 0X31) }
+  }};
+}
+#elif defined(BrlCV_SIMD_SSE2)
+struct Float {
+  static constexpr std::size_t Lanes = 4;
+  __m128 Value;
+
+  static Float load(float const *P) { return { _mm_loadu_ps(P) }; }
+  static Float broadcast(float V) { return { _mm_set1_ps(V) }; }
+  static Float broadcast(float const *P) { return { _mm_load1_ps(P) }; }
+  friend Float fma(Float A, Float B, Float C) {
+    return { _mm_add_ps(_mm_mul_ps(A.Value, B.Value), C.Value) };
+  }
+  friend Float operator-(Float A, Float B) { return { _mm_sub_ps(A.Value, B.Value) }; }
+  Float last() const { return { _mm_shuffle_ps(Value, Value, _MM_SHUFFLE(3, 3, 3, 3)) }; }
+  float first() const { return _mm_cvtss_f32(Value); }
+  friend unsigned int operator<(Float A, Float B) {
+    return _mm_movemask_ps(_mm_cmplt_ps(A.Value, B.Value));
+  }
+  friend unsigned int operator>(Float A, Float B) {
+    return _mm_movemask_ps(_mm_cmpgt_ps(A.Value, B.Value));
+  }
+  friend Float operator+(Float A, Float B) { return { _mm_add_ps(A.Value, B.Value) }; }
+  friend Float operator*(Float A, Float B) { return { _mm_mul_ps(A.Value, B.Value) }; }
+  friend Float minimum(Float A, Float B) { return { _mm_min_ps(A.Value, B.Value) }; }
+  friend Float maximum(Float A, Float B) { return { _mm_max_ps(A.Value, B.Value) }; }
+  std::array<float, Lanes> lanes() const {
+    std::array<float, Lanes> Result;
+    _mm_storeu_ps(Result.data(), Value);
+    return Result;
+  }
+};
+
+inline void transpose(std::array<Float, Float::Lanes> &Rows) {
+  _MM_TRANSPOSE4_PS(Rows[0].Value, Rows[1].Value, Rows[2].Value, Rows[3].Value);
+}
+#else
+struct Float {
+  static constexpr std::size_t Lanes = 1;
+  float Value;
+
+  static Float load(float const *P) { return { *P }; }
+  static Float broadcast(float V) { return { V }; }
+  static Float broadcast(float const *P) { return { *P }; }
+  friend Float fma(Float A, Float B, Float C) { return { A.Value * B.Value + C.Value }; }
+  friend Float operator-(Float A, Float B) { return { A.Value - B.Value }; }
+  Float last() const { return *this; }
+  float first() const { return Value; }
+  friend unsigned int operator<(Float A, Float B) { return A.Value < B.Value; }
+  friend unsigned int operator>(Float A, Float B) { return A.Value > B.Value; }
+  friend Float operator+(Float A, Float B) { return { A.Value + B.Value }; }
+  friend Float operator*(Float A, Float B) { return { A.Value * B.Value }; }
+  friend Float minimum(Float A, Float B) { return { B.Value < A.Value ? B.Value : A.Value }; }
+  friend Float maximum(Float A, Float B) { return { A.Value < B.Value ? B.Value : A.Value }; }
+  std::array<float, Lanes> lanes() const { return { Value }; }
+};
+
+inline void transpose(std::array<Float, Float::Lanes> &) {}
+#endif
+
+inline unsigned int countTrailingZeros(unsigned int Bits) {
+  Expects(Bits != 0);
+  return __builtin_ctz(Bits);
+}
+
+} // namespace SIMD
+
+// Rising edges of the difference between a fast and a slow EWMA through
+// Threshold, computed a block at a time.  Within a block of Lanes samples the
+// recurrence y[k] = w x[k] + (1 - w) y[k-1] is expanded to
+// y[k] = sum(w (1 - w)^(k-j) x[j]) + (1 - w)^(k+1) y[-1], so only one
+// dependency per block is carried.  Results match EWMA<float> up to rounding.
+class EWMAEdgeDetector {
+  using Vector = SIMD::Float;
+  static constexpr std::size_t Lanes = Vector::Lanes;
+  struct Filter {
+    float Weight, OneMinusWeight, Average;
+    // Column j holds the contribution of x[j] to each lane
+    std::array<std::array<float, Lanes>, Lanes> Columns;
+    std::array<float, Lanes> Carry;
+
+    Filter(float Weight, float Initial)
+    : Weight(Weight), OneMinusWeight(1 - Weight), Average(Initial) {
+      for (std::size_t J = 0; J < Lanes; ++J) {
+        for (std::size_t K = 0; K < Lanes; ++K) {
+          Columns[J][K] = K < J ? 0 : Weight * power(OneMinusWeight, K - J);
+        }
+        Carry[J] = power(OneMinusWeight, J + 1);
+      }
+    }
+    static float power(float Base, std::size_t Exponent) {
+      float Result = 1;
+      while (Exponent--) Result *= Base;
+      return Result;
+    }
+    float operator()(float Value) {
+      return Average = Value * Weight + Average * OneMinusWeight;
+    }
+  } Fast, Slow;
+  float const Threshold;
+  float PreviousDifference;
+
+  template<typename Position>
+  gsl::span<Position> detect(gsl::span<float const> Block, gsl::span<Position> Edges) {
+    std::size_t Found = 0;
+    // Rising holds one bit per sample in Differences, Before is the
+    // difference preceding the first of them
+    auto record = [&](std::uint32_t Base, unsigned int Rising,
+                      float const *Differences, float Before) {
+      while (Rising != 0 && Found < std::size_t(Edges.size())) {
+        auto const Lane = SIMD::countTrailingZeros(Rising);
+        if constexpr (std::is_floating_point_v<Position>) {
+          auto const Previous = Lane > 0 ? Differences[Lane - 1] : Before;
+          auto const Fraction = (Threshold - Previous) / (Differences[Lane] - Previous);
+          Edges[Found++] = Position(Base + Lane) - 1 + Fraction;
+        } else {
+          Edges[Found++] = Base + Lane;
+        }
+        Rising &= Rising - 1;
+      }
+    };
+    std::size_t const Size = Block.size();
+    std::size_t Offset = 0;
+    unsigned int PreviousBelow = PreviousDifference < Threshold;
+
+    if constexpr (Lanes > 1) {
+      auto const Limit = Vector::broadcast(Threshold);
+      auto FastAverage = Vector::broadcast(Fast.Average);
+      auto SlowAverage = Vector::broadcast(Slow.Average);
+      auto const FastCarry = Vector::load(Fast.Carry.data());
+      auto const SlowCarry = Vector::load(Slow.Carry.data());
+      auto Previous = Vector::broadcast(PreviousDifference);
+
+      for (; Offset + Lanes <= Size; Offset += Lanes) {
+        auto FastLanes = Vector::broadcast(0.0F), SlowLanes = FastLanes;
+        for (std::size_t J = 0; J < Lanes; ++J) {
+          auto const Sample = Vector::broadcast(&Block[Offset + J]);
+          FastLanes = fma(Vector::load(Fast.Columns[J].data()), Sample, FastLanes);
+          SlowLanes = fma(Vector::load(Slow.Columns[J].data()), Sample, SlowLanes);
+        }
+        FastLanes = fma(FastCarry, FastAverage, FastLanes);
+        SlowLanes = fma(SlowCarry, SlowAverage, SlowLanes);
+        auto const Difference = FastLanes - SlowLanes;
+        auto const Below = Difference < Limit;
+        auto const Rising = (Difference > Limit) & ((Below << 1) | PreviousBelow);
+        if (Rising != 0) {
+          record(Offset, Rising, Difference.lanes().data(), Previous.last().first());
+        }
+        PreviousBelow = (Below >> (Lanes - 1)) & 1;
+        Previous = Difference;
+        FastAverage = FastLanes.last();
+        SlowAverage = SlowLanes.last();
+      }
+      Fast.Average = FastAverage.first();
+      Slow.Average = SlowAverage.first();
+      PreviousDifference = Previous.last().first();
+    }
+
+    for (; Offset < Size; ++Offset) {
+      auto const Difference = Fast(Block[Offset]) - Slow(Block[Offset]);
+      record(Offset, PreviousBelow && Difference > Threshold, &Difference, PreviousDifference);
+      PreviousBelow = Difference < Threshold;
+      PreviousDifference = Difference;
+    }
+
+    return Edges.first(Found);
+  }
+
+public:
+  EWMAEdgeDetector(float FastWeight, float SlowWeight, float Threshold,
+                   float Initial = 0)
+  : Fast(FastWeight, Initial), Slow(SlowWeight, Initial), Threshold(Threshold)
+  , PreviousDifference(0)
+  {
+    Expects(FastWeight > 0 && FastWeight <= 1);
+    Expects(SlowWeight > 0 && SlowWeight <= 1);
+  }
+
+  float difference() const noexcept { return Fast.Average - Slow.Average; }
+
+  // Writes the offsets of rising edges in Block to Edges and returns the
+  // used part of it.  Edges beyond the capacity of Edges are not reported.
+  gsl::span<std::uint32_t>
+  operator()(gsl::span<float const> Block, gsl::span<std::uint32_t> Edges) {
+    return detect(Block, Edges);
+  }
+  // Same with the threshold crossing linearly interpolated between samples,
+  // so offsets are in (-1, Block.size() - 1].
+  gsl::span<float>
+  operator()(gsl::span<float const> Block, gsl::span<float> Edges) {
+    return detect(Block, Edges);
+  }
+};
+
+// EWMAEdgeDetector for several channels at once.  The filter state is kept
+// as a structure of arrays with one channel per SIMD lane, so each frame
+// advances Lanes channels with one vector operation.  Edges are reported
+// with fractional positions like EWMAEdgeDetector.
+class EWMAEdgeDetectorBank {
+  using Vector = SIMD::Float;
+  static constexpr std::size_t Lanes = Vector::Lanes;
+  std::size_t const Channels;
+  float const FastWeight, SlowWeight;
+  float Threshold;
+  std::vector<float> Fast, Slow, Previous;
+
+public:
+  EWMAEdgeDetectorBank(std::size_t Channels, float FastWeight, float SlowWeight,
+                       float Threshold)
+  : Channels(Channels)
+  , FastWeight(FastWeight), SlowWeight(SlowWeight), Threshold(Threshold)
+  , Fast((Channels + Lanes - 1) / Lanes * Lanes)
+  , Slow(Fast.size()), Previous(Fast.size())
+  {
+    Expects(Channels > 0);
+    Expects(FastWeight > 0 && FastWeight <= 1);
+    Expects(SlowWeight > 0 && SlowWeight <= 1);
+  }
+
+  std::size_t channels() const noexcept { return Channels; }
+  float threshold() const noexcept { return Threshold; }
+  // Takes effect with the next block
+  void setThreshold(float Value) {
+    Expects(Value > 0);
+    Threshold = Value;
+  }
+
+  // Blocks holds one pointer to Frames samples per channel.  Calls
+  // edge(Channel, Position) for every rising edge, in time order per channel.
+  // FrameCount is std::uint32_t, or a constant like std::integral_constant
+  // to instantiate the kernel with a fixed trip count.
+  template<typename FrameCount, typename Edge>
+  void operator()(gsl::span<float const *const> Blocks, FrameCount Count, Edge edge) {
+    Expects(std::size_t(Blocks.size()) == Channels);
+    auto const Frames = static_cast<std::uint32_t>(Count);
+    auto const FastNew = Vector::broadcast(FastWeight);
+    auto const FastOld = Vector::broadcast(1 - FastWeight);
+    auto const SlowNew = Vector::broadcast(SlowWeight);
+    auto const SlowOld = Vector::broadcast(1 - SlowWeight);
+    auto const Limit = Vector::broadcast(Threshold);
+    auto const Zero = Vector::broadcast(0.0F);
+    std::array<Vector, Lanes> Rows;
+
+    for (std::size_t Group = 0; Group < Fast.size(); Group += Lanes) {
+      auto const Used = std::min(Lanes, Channels - Group);
+      auto const UsedLanes = (1U << Used) - 1;
+      auto FastLanes = Vector::load(&Fast[Group]);
+      auto SlowLanes = Vector::load(&Slow[Group]);
+      auto PreviousLanes = Vector::load(&Previous[Group]);
+      auto PreviousBelow = PreviousLanes < Limit;
+
+      for (std::uint32_t Frame = 0; Frame < Frames; Frame += Lanes) {
+        auto const Count = std::min<std::uint32_t>(Lanes, Frames - Frame);
+        // Transpose so that each row holds one frame of all channels
+        if (Count == Lanes) {
+          for (std::size_t Lane = 0; Lane < Lanes; ++Lane) {
+            Rows[Lane] = Lane < Used ? Vector::load(Blocks[Group + Lane] + Frame) : Zero;
+          }
+          SIMD::transpose(Rows);
+        } else {
+          std::array<std::array<float, Lanes>, Lanes> Tile{};
+          for (std::size_t Lane = 0; Lane < Used; ++Lane) {
+            auto const Samples = Blocks[Group + Lane] + Frame;
+            for (std::size_t J = 0; J < Count; ++J) Tile[J][Lane] = Samples[J];
+          }
+          for (std::size_t J = 0; J < Count; ++J) Rows[J] = Vector::load(Tile[J].data());
+        }
+        for (std::size_t J = 0; J < Count; ++J) {
+          auto const Sample = Rows[J];
+          FastLanes = fma(Sample, FastNew, FastLanes * FastOld);
+          SlowLanes = fma(Sample, SlowNew, SlowLanes * SlowOld);
+          auto const Difference = FastLanes - SlowLanes;
+          auto const Rising = (Difference > Limit) & PreviousBelow & UsedLanes;
+          if (Rising != 0) {
+            auto const After = Difference.lanes(), Before = PreviousLanes.lanes();
+            for (auto Bits = Rising; Bits != 0; Bits &= Bits - 1) {
+              auto const Lane = SIMD::countTrailingZeros(Bits);
+              auto const Fraction = (Threshold - Before[Lane]) / (After[Lane] - Before[Lane]);
+              edge(Group + Lane, float(Frame + J) - 1 + Fraction);
+            }
+          }
+          PreviousBelow = Difference < Limit;
+          PreviousLanes = Difference;
+        }
+      }
+      std::copy_n(FastLanes.lanes().begin(), Lanes, &Fast[Group]);
+      std::copy_n(SlowLanes.lanes().begin(), Lanes, &Slow[Group]);
+      std::copy_n(PreviousLanes.lanes().begin(), Lanes, &Previous[Group]);
+    }
+  }
+};
+
+// Second order (alpha-beta) phase-locked loop following a pulse train given
+// as fractional frame positions.  Beta = Alpha^2 / (2 - Alpha) makes the
+// loop critically damped.  Pulses closer than half a period to the previous
+// one are ignored as glitches; pulses further than Tolerance periods from
+// the prediction, or after more than MaximumGap periods, relock.
+class PhaseLockedLoop {
+  double const Alpha, Beta, Tolerance;
+  std::uint64_t const MaximumGap;
+  double Anchor = 0, Period = 0, LastPulse = 0;
+  std::uint64_t Advanced = 0;
+  bool HaveLastPulse = false, Locked = false;
+
+public:
+  enum class Update { Ignored, Acquired, Tracked };
+
+  explicit PhaseLockedLoop(double Alpha = 0.2, double Tolerance = 0.25,
+                           std::uint64_t MaximumGap = 2)
+  : Alpha(Alpha), Beta(Alpha * Alpha / (2 - Alpha))
+  , Tolerance(Tolerance), MaximumGap(MaximumGap)
+  {
+    Expects(Alpha > 0 && Alpha <= 1);
+    Expects(Tolerance > 0 && Tolerance < 0.5);
+    Expects(MaximumGap > 0);
+  }
+
+  Update operator()(double Time) {
+    auto relock = [&] {
+      auto const Interval = Time - LastPulse;
+      LastPulse = Time;
+      if (!HaveLastPulse || Interval <= 0) {
+        HaveLastPulse = true;
+        Locked = false;
+        return Update::Ignored;
+      }
+      Anchor = Time;
+      Period = Interval;
+      Locked = true;
+      return Update::Acquired;
+    };
+    if (!Locked) return relock();
+
+    auto const Periods = std::round((Time - Anchor) / Period);
+    if (Periods < 1) return Update::Ignored;
+    auto const Error = Time - (Anchor + Periods * Period);
+    if (Periods > MaximumGap || std::abs(Error) > Tolerance * Period) return relock();
+
+    LastPulse = Time;
+    Advanced = static_cast<std::uint64_t>(Periods);
+    Anchor += Periods * Period + Alpha * Error;
+    Period += Beta * Error / Periods;
+    return Update::Tracked;
+  }
+
+  bool locked() const noexcept { return Locked; }
+  // Smoothed time of the latest pulse and frames per pulse
+  double anchor() const noexcept { return Anchor; }
+  double period() const noexcept { return Period; }
+  // Periods between the previous and the latest anchor after Update::Tracked
+  std::uint64_t advanced() const noexcept { return Advanced; }
+  void reset() noexcept { HaveLastPulse = Locked = false; }
+};
+
+// Count, minimum, maximum, mean and (population) variance of a stream of
+// samples, fed a block at a time.  Each chunk of a block is reduced in SIMD
+// lanes with two passes (sum/min/max, then squared deviations from the chunk
+// mean) and merged into the running totals with Chan's parallel update.
+class StreamingStatistics {
+  using Vector = SIMD::Float;
+  static constexpr std::size_t Lanes = Vector::Lanes;
+  static constexpr std::size_t ChunkSize = 256;
+  std::uint64_t Count = 0;
+  double Mean = 0, M2 = 0;
+  float Min = std::numeric_limits<float>::infinity();
+  float Max = -std::numeric_limits<float>::infinity();
+
+  void chunk(gsl::span<float const> Chunk) {
+    std::size_t const Size = Chunk.size();
+    std::size_t Offset = 0;
+    auto Sum = Vector::broadcast(0.0F);
+    auto Low = Vector::broadcast(Min), High = Vector::broadcast(Max);
+    for (; Offset + Lanes <= Size; Offset += Lanes) {
+      auto const Samples = Vector::load(&Chunk[Offset]);
+      Sum = Sum + Samples;
+      Low = minimum(Low, Samples);
+      High = maximum(High, Samples);
+    }
+    float Total = 0;
+    for (auto Lane: Sum.lanes()) Total += Lane;
+    for (auto Lane: Low.lanes()) Min = std::min(Min, Lane);
+    for (auto Lane: High.lanes()) Max = std::max(Max, Lane);
+    for (; Offset < Size; ++Offset) {
+      Total += Chunk[Offset];
+      Min = std::min(Min, Chunk[Offset]);
+      Max = std::max(Max, Chunk[Offset]);
+    }
+
+    float const ChunkMean = Total / Size;
+    auto const Center = Vector::broadcast(ChunkMean);
+    auto Squares = Vector::broadcast(0.0F);
+    for (Offset = 0; Offset + Lanes <= Size; Offset += Lanes) {
+      auto const Deviation = Vector::load(&Chunk[Offset]) - Center;
+      Squares = fma(Deviation, Deviation, Squares);
+    }
+    float ChunkM2 = 0;
+    for (auto Lane: Squares.lanes()) ChunkM2 += Lane;
+    for (; Offset < Size; ++Offset) {
+      ChunkM2 += (Chunk[Offset] - ChunkMean) * (Chunk[Offset] - ChunkMean);
+    }
+
+    merge(Size, ChunkMean, ChunkM2);
+  }
+
+  void merge(std::uint64_t OtherCount, double OtherMean, double OtherM2) {
+    if (OtherCount == 0) return;
+    auto const Total = Count + OtherCount;
+    auto const Delta = OtherMean - Mean;
+    Mean += Delta * OtherCount / Total;
+    M2 += OtherM2 + Delta * Delta * Count * OtherCount / Total;
+    Count = Total;
+  }
+
+public:
+  StreamingStatistics &operator()(gsl::span<float const> Block) {
+    for (std::ptrdiff_t Offset = 0; Offset < Block.size(); Offset += ChunkSize) {
+      chunk(Block.subspan(
+        Offset, std::min<std::ptrdiff_t>(ChunkSize, Block.size() - Offset)
+      ));
+    }
+    return *this;
+  }
+  StreamingStatistics &operator+=(StreamingStatistics const &Other) {
+    Min = std::min(Min, Other.Min);
+    Max = std::max(Max, Other.Max);
+    merge(Other.Count, Other.Mean, Other.M2);
+    return *this;
+  }
+
+  std::uint64_t count() const noexcept { return Count; }
+  float min() const noexcept { return Min; }
+  float max() const noexcept { return Max; }
+  double mean() const noexcept { return Mean; }
+  double variance() const noexcept { return Count > 0 ? M2 / Count : 0; }
+};
+
+// Reduces a stream to one minimum/maximum pair per Factor samples, the
+// envelope a scope or level meter draws.  Buckets span block boundaries.
+class MinMaxDecimator {
+  using Vector = SIMD::Float;
+  static constexpr std::size_t Lanes = Vector::Lanes;
+  std::uint32_t Factor, Remaining;
+  float Min = std::numeric_limits<float>::infinity();
+  float Max = -std::numeric_limits<float>::infinity();
+
+  void reduce(float const *Samples, std::size_t Count) {
+    std::size_t Offset = 0;
+    if (Count >= Lanes) {
+      auto Low = Vector::broadcast(Min), High = Vector::broadcast(Max);
+      for (; Offset + Lanes <= Count; Offset += Lanes) {
+        auto const Block = Vector::load(Samples + Offset);
+        Low = minimum(Low, Block);
+        High = maximum(High, Block);
+      }
+      for (auto Lane: Low.lanes()) Min = std::min(Min, Lane);
+      for (auto Lane: High.lanes()) Max = std::max(Max, Lane);
+    }
+    for (; Offset < Count; ++Offset) {
+      Min = std::min(Min, Samples[Offset]);
+      Max = std::max(Max, Samples[Offset]);
+    }
+  }
+
+public:
+  explicit MinMaxDecimator(std::uint32_t Factor)
+  : Factor(Factor), Remaining(Factor) { Expects(Factor > 0); }
+
+  std::uint32_t factor() const noexcept { return Factor; }
+
+  // Calls bucket(float Min, float Max) for every completed bucket
+  template<typename Bucket>
+  void operator()(gsl::span<float const> Block, Bucket &&bucket) {
+    std::size_t const Size = Block.size();
+    for (std::size_t Offset = 0; Offset < Size;) {
+      auto const Count = std::min<std::size_t>(Remaining, Size - Offset);
+      reduce(&Block[Offset], Count);
+      Offset += Count;
+      Remaining -= Count;
+      if (Remaining == 0) {
+        bucket(Min, Max);
+        Min = std::numeric_limits<float>::infinity();
+        Max = -std::numeric_limits<float>::infinity();
+        Remaining = Factor;
+      }
+    }
+  }
+};
+
+// Fixed-bin histogram of samples in [Lower, Upper) with underflow (also
+// taking NaN) and overflow bins.  Memory is allocated at construction, each
+// sample costs one increment.
+class Histogram {
+  float Lower, Upper, Scale;
+  std::vector<std::uint64_t> Bins;
+  std::uint64_t Count = 0;
+
+public:
+  Histogram(float Lower, float Upper, std::size_t BinCount = 2048)
+  : Lower(Lower), Upper(Upper), Scale(BinCount / (Upper - Lower))
+  , Bins(BinCount + 2)
+  {
+    Expects(Lower < Upper);
+    Expects(BinCount > 0);
+  }
+
+  Histogram &operator()(gsl::span<float const> Block) {
+    auto const Last = static_cast<float>(Bins.size() - 2);
+    for (auto Sample: Block) {
+      auto const Position = std::max(-1.0F, std::min((Sample - Lower) * Scale, Last));
+      Bins[static_cast<std::size_t>(Position + 1)] += 1;
+    }
+    Count += Block.size();
+    return *this;
+  }
+  Histogram &operator+=(Histogram const &Other) {
+    Expects(Lower == Other.Lower && Upper == Other.Upper);
+    Expects(Bins.size() == Other.Bins.size());
+    for (std::size_t I = 0; I < Bins.size(); ++I) Bins[I] += Other.Bins[I];
+    Count += Other.Count;
+    return *this;
+  }
+
+  std::uint64_t count() const noexcept { return Count; }
+  std::uint64_t underflow() const noexcept { return Bins.front(); }
+  std::uint64_t overflow() const noexcept { return Bins.back(); }
+
+  // Interpolated within the bin, clamped to [Lower, Upper]
+  float quantile(double Probability) const {
+    Expects(Probability >= 0 && Probability <= 1);
+    if (Count == 0) return std::numeric_limits<float>::quiet_NaN();
+    auto const Rank = Probability * Count;
+    double Cumulative = 0;
+    for (std::size_t I = 0; I < Bins.size(); ++I) {
+      if (Bins[I] != 0 && Cumulative + Bins[I] >= Rank) {
+        if (I == 0) return Lower;
+        if (I == Bins.size() - 1) return Upper;
+        auto const Fraction = (Rank - Cumulative) / Bins[I];
+        return Lower + static_cast<float>((I - 1 + Fraction) / Scale);
+      }
+      Cumulative += Bins[I];
+    }
+    return Upper;
+  }
+};
+
 template<std::size_t N>
 class FairSegmentation {
   std::size_t SegmentSize{0};
@@ -36,7 +657,7 @@ public:
   FairSegmentation() : Set(0) {}
   explicit FairSegmentation(std::size_t Size) : SegmentSize(Size / N), Set(0) {
     auto const R = Size % N;
-    for (auto I = 0; I < R; ++I) {
+    for (std::size_t I = 0; I < R; ++I) {
       Set.set(N*I/R);
     }
     Ensures(Set.count() == R);
@@ -46,10 +667,12 @@ public:
     SegmentSize = Size / N;
     Set.reset();
     auto const R = Size % N;
-    for (auto I = 0; I < R; ++I) {
+    for (std::size_t I = 0; I < R; ++I) {
       Set.set(N*I/R);
     }
     Ensures(Set.count() == R);
+
+    return *this;
   }
 
   constexpr bool empty() const noexcept { return N == 0; }
@@ -0,0 +1,246 @@
+#include <graph.hpp>
+#include <notifier.hpp>
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+void pause() noexcept {
+#if defined(__SSE2__)
+  _mm_pause();
+#endif
+}
+
+constexpr auto None = ~std::size_t(0);
+
+} // namespace
+
+template<> struct BrlCV::impl_ptr<JACK::Graph>::implementation {
+  struct Node {
+    JACK::Graph::Work Body;
+    std::vector<std::size_t> Inputs, Outputs, Successors;
+    std::vector<float *> InputBuffers, OutputBuffers;
+    std::uint32_t Predecessors = 0;
+  };
+
+  JACK::Client &Owner;
+  std::size_t const WorkerCount;
+  std::vector<Node> Nodes;
+  std::vector<std::vector<float>> Buffers;
+  std::vector<std::size_t> Order, Roots;
+  std::uint32_t Capacity = 0;
+  bool Prepared = false;
+
+  // Shared with the workers while a cycle runs
+  std::uint32_t Frames = 0;
+  std::unique_ptr<std::atomic<std::uint32_t>[]> Pending;
+  std::atomic<std::size_t> Completed { 0 };
+  // Ready nodes.  Every node becomes ready exactly once per cycle, so a
+  // ring of one slot per node never wraps within a cycle.  Head and the
+  // slots carry the cycle number in their upper half so that a worker
+  // delayed across cycles cannot take a stale entry.
+  std::unique_ptr<std::atomic<std::uint64_t>[]> Ring;
+  std::atomic<std::uint64_t> Head { 0 };
+  std::atomic<std::uint32_t> Tail { 0 };
+  std::atomic<std::uint32_t> Generation { 0 };
+  std::atomic<bool> Stop { false };
+  BrlCV::Notifier Ready;
+  std::vector<JACK::RealtimeThread> Workers;
+
+  implementation(JACK::Client &Owner, std::size_t Workers)
+  : Owner(Owner), WorkerCount(Workers) {}
+  ~implementation() {
+    Stop = true;
+    Ready.notify();
+    Workers.clear();
+  }
+
+  void push(std::size_t Index) noexcept {
+    auto const Slot = Tail.fetch_add(1, std::memory_order_relaxed);
+    auto const Cycle = std::uint64_t(Generation.load(std::memory_order_relaxed)) << 32;
+    Ring[Slot].store(Cycle | (Index + 1), std::memory_order_release);
+    Ready.notify();
+  }
+  std::size_t pop() noexcept {
+    auto Current = Head.load(std::memory_order_acquire);
+    while (true) {
+      auto const Slot = std::uint32_t(Current);
+      if (Slot >= Nodes.size()) return None;
+      auto const Entry = Ring[Slot].load(std::memory_order_acquire);
+      if ((Entry >> 32) != (Current >> 32) || std::uint32_t(Entry) == 0) return None;
+      if (Head.compare_exchange_weak(Current, Current + 1, std::memory_order_acq_rel,
+                                     std::memory_order_acquire)) {
+        return std::uint32_t(Entry) - 1;
+      }
+    }
+  }
+  void execute(std::size_t Index) {
+    auto &Node = Nodes[Index];
+    Node.Body(JACK::Cycle(Frames, Node.InputBuffers, Node.OutputBuffers));
+    for (auto const Successor: Node.Successors) {
+      if (Pending[Successor].fetch_sub(1, std::memory_order_acq_rel) == 1) push(Successor);
+    }
+    Completed.fetch_add(1, std::memory_order_release);
+  }
+
+  void work() {
+    while (true) {
+      auto Index = None;
+      Ready.wait([&] { return Stop || (Index = pop()) != None; });
+      if (Index == None) return;
+      execute(Index);
+    }
+  }
+
+  void sort() {
+    std::vector<std::uint32_t> Remaining(Nodes.size());
+    for (std::size_t I = 0; I < Nodes.size(); ++I) {
+      Remaining[I] = Nodes[I].Predecessors;
+      if (Remaining[I] == 0) Roots.push_back(I);
+    }
+    Order = Roots;
+    for (std::size_t I = 0; I < Order.size(); ++I) {
+      for (auto const Successor: Nodes[Order[I]].Successors) {
+        if (--Remaining[Successor] == 0) Order.push_back(Successor);
+      }
+    }
+    if (Order.size() != Nodes.size()) {
+      throw std::logic_error("JACK::Graph: Nodes depend on each other in a cycle");
+    }
+  }
+
+  void link(std::size_t Before, std::size_t After) {
+    auto &Successors = Nodes[Before].Successors;
+    if (std::find(Successors.begin(), Successors.end(), After) != Successors.end()) return;
+    Successors.push_back(After);
+    ++Nodes[After].Predecessors;
+  }
+
+  void resize(std::uint32_t FrameCount) {
+    Capacity = FrameCount;
+    for (auto &Buffer: Buffers) Buffer.assign(FrameCount, 0);
+    for (auto &Node: Nodes) {
+      Node.InputBuffers.clear();
+      for (auto const Buffer: Node.Inputs) Node.InputBuffers.push_back(Buffers[Buffer].data());
+      Node.OutputBuffers.clear();
+      for (auto const Buffer: Node.Outputs) Node.OutputBuffers.push_back(Buffers[Buffer].data());
+    }
+  }
+};
+
+namespace JACK {
+
+Graph::Graph(Client &Owner, std::size_t Workers) : impl_ptr(Owner, Workers) {}
+
+Graph::~Graph() = default;
+
+std::size_t Graph::workers() const noexcept { return (*this)->Workers.size(); }
+
+Graph::BufferId Graph::buffer() {
+  Expects(!(*this)->Prepared);
+  (*this)->Buffers.emplace_back();
+  return BufferId((*this)->Buffers.size() - 1);
+}
+
+Graph::NodeId Graph::node(Work Body, std::vector<BufferId> Inputs, std::vector<BufferId> Outputs) {
+  Expects(!(*this)->Prepared && Body);
+  implementation::Node Node;
+  Node.Body = std::move(Body);
+  for (auto const Buffer: Inputs) Node.Inputs.push_back(std::size_t(Buffer));
+  for (auto const Buffer: Outputs) Node.Outputs.push_back(std::size_t(Buffer));
+  (*this)->Nodes.push_back(std::move(Node));
+  return NodeId((*this)->Nodes.size() - 1);
+}
+
+void Graph::order(NodeId Before, NodeId After) {
+  Expects(!(*this)->Prepared);
+  Expects(std::size_t(Before) < (*this)->Nodes.size() && std::size_t(After) < (*this)->Nodes.size());
+  (*this)->link(std::size_t(Before), std::size_t(After));
+}
+
+void Graph::prepare() {
+  auto &Self = **this;
+  Expects(!Self.Prepared);
+  std::vector<std::size_t> Writer(Self.Buffers.size(), None);
+  for (std::size_t I = 0; I < Self.Nodes.size(); ++I) {
+    for (auto const Buffer: Self.Nodes[I].Outputs) {
+      Expects(Buffer < Writer.size());
+      if (Writer[Buffer] != None) {
+        throw std::logic_error("JACK::Graph: Buffer " + std::to_string(Buffer) +
+                               " has more than one writer");
+      }
+      Writer[Buffer] = I;
+    }
+  }
+  // Inputs nobody writes stay silent
+  for (std::size_t I = 0; I < Self.Nodes.size(); ++I) {
+    for (auto const Buffer: Self.Nodes[I].Inputs) {
+      Expects(Buffer < Writer.size());
+      if (Writer[Buffer] == I) {
+        throw std::logic_error("JACK::Graph: Node " + std::to_string(I) +
+                               " reads its own output");
+      }
+      if (Writer[Buffer] != None) Self.link(Writer[Buffer], I);
+    }
+  }
+  Self.sort();
+  Self.resize(Self.Owner.bufferSize());
+
+  Self.Pending = std::make_unique<std::atomic<std::uint32_t>[]>(Self.Nodes.size());
+  Self.Ring = std::make_unique<std::atomic<std::uint64_t>[]>(Self.Nodes.size());
+  for (std::size_t I = 0; I < Self.Nodes.size(); ++I) Self.Ring[I] = 0;
+  Self.Head = std::uint64_t(Self.Nodes.size());
+  Self.Prepared = true;
+  if (Self.Nodes.size() > 1) {
+    for (std::size_t I = 0; I < Self.WorkerCount; ++I) {
+      Self.Workers.push_back(Self.Owner.createRealtimeThread([&Self] { Self.work(); }));
+    }
+  }
+}
+
+void Graph::resize(std::uint32_t FrameCount) {
+  Expects((*this)->Prepared);
+  (*this)->resize(FrameCount);
+}
+
+void Graph::run(std::uint32_t FrameCount) {
+  auto &Self = **this;
+  Expects(Self.Prepared && FrameCount <= Self.Capacity);
+  Self.Frames = FrameCount;
+  if (Self.Workers.empty()) {
+    for (auto const Index: Self.Order) {
+      auto &Node = Self.Nodes[Index];
+      Node.Body(Cycle(FrameCount, Node.InputBuffers, Node.OutputBuffers));
+    }
+    return;
+  }
+
+  for (std::size_t I = 0; I < Self.Nodes.size(); ++I) {
+    Self.Pending[I].store(Self.Nodes[I].Predecessors, std::memory_order_relaxed);
+  }
+  Self.Completed.store(0, std::memory_order_relaxed);
+  Self.Tail.store(0, std::memory_order_relaxed);
+  auto const Generation = Self.Generation.load(std::memory_order_relaxed) + 1;
+  Self.Generation.store(Generation, std::memory_order_relaxed);
+  Self.Head.store(std::uint64_t(Generation) << 32, std::memory_order_release);
+  for (auto const Root: Self.Roots) Self.push(Root);
+
+  // Work along instead of waiting, and only spin while others finish
+  while (Self.Completed.load(std::memory_order_acquire) < Self.Nodes.size()) {
+    auto const Index = Self.pop();
+    if (Index != None) {
+      Self.execute(Index);
+    } else {
+      pause();
+    }
+  }
+}
+
+} // namespace JACK
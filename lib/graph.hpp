@@ -0,0 +1,69 @@
+#if !defined(BrlCV_GRAPH_HPP)
+#define BrlCV_GRAPH_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <gsl/gsl>
+
+#include <impl_ptr.hpp>
+#include <jack.hpp>
+
+namespace JACK {
+
+// The buffers of one node for the current cycle
+class Cycle {
+  std::uint32_t Frames;
+  gsl::span<float *const> Inputs, Outputs;
+
+public:
+  Cycle(std::uint32_t Frames, gsl::span<float *const> Inputs, gsl::span<float *const> Outputs)
+  : Frames(Frames), Inputs(Inputs), Outputs(Outputs) {}
+
+  std::uint32_t frames() const noexcept { return Frames; }
+  gsl::span<float const> input(std::size_t Index) const { return { Inputs[Index], Frames }; }
+  gsl::span<float> output(std::size_t Index) const { return { Outputs[Index], Frames }; }
+};
+
+// Splits the work of one process() call into nodes that exchange samples
+// through buffers owned by the graph.  A node runs once the writers of its
+// inputs (and the nodes ordered before it) are done, so independent
+// branches run in parallel on a pool of real-time worker threads.  The
+// calling thread works on the graph as well and only ever waits for nodes
+// that are already running, so a worker that is scheduled late cannot
+// make the cycle miss its deadline.
+class Graph : BrlCV::impl_ptr<Graph>::unique {
+public:
+  enum class BufferId : std::size_t {};
+  enum class NodeId : std::size_t {};
+  using Work = std::function<void(Cycle const &)>;
+
+  explicit Graph(Client &,
+                 std::size_t Workers = std::max(1U, std::thread::hardware_concurrency()) - 1);
+  ~Graph();
+  Graph(Graph const &) = delete;
+  Graph &operator=(Graph const &) = delete;
+
+  BufferId buffer();
+  NodeId node(Work, std::vector<BufferId> Inputs, std::vector<BufferId> Outputs);
+  // For nodes that share state other than graph buffers, like a port
+  void order(NodeId Before, NodeId After);
+
+  // Sorts the nodes, sizes the buffers and starts the workers.  Throws
+  // std::logic_error for cycles and buffers with more than one writer.
+  void prepare();
+  // Not real-time safe, call from Client::bufferSizeChanged()
+  void resize(std::uint32_t FrameCount);
+  // Runs every node once, from Client::process()
+  void run(std::uint32_t FrameCount);
+
+  std::size_t workers() const noexcept;
+};
+
+} // namespace JACK
+
+#endif // BrlCV_GRAPH_HPP
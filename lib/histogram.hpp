@@ -0,0 +1,142 @@
+#if !defined(BrlCV_HISTOGRAM_HPP)
+#define BrlCV_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gsl/gsl>
+
+namespace BrlCV {
+
+// Log-linear (HDR style) histogram of non-negative integers up to Highest.
+// Values below 2^SignificantBits are counted exactly, larger values in
+// buckets whose width keeps the relative error below 2^-(SignificantBits-1).
+// Memory is fixed at construction and recording is O(1).
+class LogLinearHistogram {
+  unsigned int SignificantBits;
+  std::uint64_t Highest;
+  std::vector<std::uint64_t> Counts;
+  std::uint64_t Count = 0, Sum = 0;
+  std::uint64_t Min = std::numeric_limits<std::uint64_t>::max(), Max = 0;
+
+  static unsigned int log2(std::uint64_t Value) {
+    return 63 - __builtin_clzll(Value);
+  }
+  std::uint64_t linear() const noexcept { return std::uint64_t(1) << SignificantBits; }
+  std::size_t index(std::uint64_t Value) const noexcept {
+    if (Value < linear()) return Value;
+    auto const Shift = log2(Value) - SignificantBits + 1;
+    auto const Half = linear() / 2;
+    return linear() + (Shift - 1) * Half + ((Value >> Shift) - Half);
+  }
+  std::uint64_t highestEquivalent(std::size_t Index) const noexcept {
+    if (Index < linear()) return Index;
+    auto const Half = linear() / 2;
+    auto const Shift = (Index - linear()) / Half + 1;
+    auto const Lowest = ((Index - linear()) % Half + Half) << Shift;
+    return Lowest + (std::uint64_t(1) << Shift) - 1;
+  }
+
+public:
+  explicit LogLinearHistogram(std::uint64_t Highest = 10'000'000,
+                              unsigned int SignificantBits = 7)
+  : SignificantBits(SignificantBits), Highest(Highest)
+  {
+    Expects(SignificantBits >= 2 && SignificantBits <= 20);
+    Expects(Highest > 0);
+    Counts.resize(index(Highest) + 1);
+  }
+
+  void record(std::uint64_t Value, std::uint64_t Times = 1) {
+    Counts[index(std::min(Value, Highest))] += Times;
+    Count += Times;
+    Sum += Value * Times;
+    Min = std::min(Min, Value);
+    Max = std::max(Max, Value);
+  }
+  void operator()(std::uint64_t Value) { record(Value); }
+
+  LogLinearHistogram &operator+=(LogLinearHistogram const &Other) {
+    Expects(SignificantBits == Other.SignificantBits);
+    Expects(Highest == Other.Highest);
+    for (std::size_t I = 0; I < Counts.size(); ++I) Counts[I] += Other.Counts[I];
+    Count += Other.Count;
+    Sum += Other.Sum;
+    Min = std::min(Min, Other.Min);
+    Max = std::max(Max, Other.Max);
+    return *this;
+  }
+
+  std::uint64_t count() const noexcept { return Count; }
+  std::uint64_t min() const noexcept { return Count > 0 ? Min : 0; }
+  std::uint64_t max() const noexcept { return Max; }
+  double mean() const noexcept { return Count > 0 ? double(Sum) / Count : 0; }
+
+  // Highest value equivalent to the one at Percent (0-100), never above max()
+  std::uint64_t percentile(double Percent) const {
+    Expects(Percent >= 0 && Percent <= 100);
+    if (Count == 0) return 0;
+    auto const Rank = std::max<std::uint64_t>(
+      1, static_cast<std::uint64_t>(std::ceil(Percent / 100 * Count))
+    );
+    std::uint64_t Cumulative = 0;
+    for (std::size_t I = 0; I < Counts.size(); ++I) {
+      Cumulative += Counts[I];
+      if (Cumulative >= Rank) return std::min(highestEquivalent(I), Max);
+    }
+    return Max;
+  }
+
+  // Text format, lines starting with '#' are ignored by load()
+  void save(std::ostream &Out) const {
+    Out << "BrlCV-LogLinearHistogram 1\n"
+        << SignificantBits << ' ' << Highest << ' ' << Count << ' '
+        << Min << ' ' << Max << ' ' << Sum << '\n';
+    for (std::size_t I = 0; I < Counts.size(); ++I) {
+      if (Counts[I] != 0) Out << I << ' ' << Counts[I] << '\n';
+    }
+  }
+  static LogLinearHistogram load(std::istream &In) {
+    auto skipComments = [&] {
+      while (In >> std::ws && In.peek() == '#') {
+        In.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+      }
+    };
+    std::string Magic;
+    int Version;
+    skipComments();
+    if (!(In >> Magic >> Version) || Magic != "BrlCV-LogLinearHistogram" || Version != 1) {
+      throw std::runtime_error("Not a histogram file");
+    }
+    unsigned int Bits;
+    std::uint64_t Highest, Count, Min, Max, Sum;
+    if (!(In >> Bits >> Highest >> Count >> Min >> Max >> Sum) || Bits < 2 || Bits > 20) {
+      throw std::runtime_error("Malformed histogram header");
+    }
+    LogLinearHistogram Histogram(Highest, Bits);
+    Histogram.Count = Count;
+    Histogram.Min = Min;
+    Histogram.Max = Max;
+    Histogram.Sum = Sum;
+    std::size_t Index;
+    std::uint64_t Times;
+    for (skipComments(); In >> Index >> Times; skipComments()) {
+      if (Index >= Histogram.Counts.size()) {
+        throw std::runtime_error("Histogram bucket out of range");
+      }
+      Histogram.Counts[Index] = Times;
+    }
+    return Histogram;
+  }
+};
+
+} // namespace BrlCV
+
+#endif // BrlCV_HISTOGRAM_HPP
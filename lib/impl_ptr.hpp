@@ -1,17 +1,29 @@
 #if !defined(BrlCV_IMPL_PTR)
 #define BrlCV_IMPL_PTR
 
+#include <cstddef>
 #include <experimental/propagate_const>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace BrlCV {
 
 template<typename> struct impl_ptr {
   struct implementation;
   template<typename> class base;
+  template<std::size_t, std::size_t> class inline_base;
 
   using shared = base<std::shared_ptr<implementation>>;
   using unique = base<std::unique_ptr<implementation>>;
+  // Keeps the implementation inside the object instead of on the heap.
+  // Size and Alignment are checked against the implementation where it is
+  // complete, so the owner's constructors, destructor and moves must be
+  // defined there.  Moves move-construct the implementation, which has to
+  // leave its source in a state that is safe to destroy.
+  template<std::size_t Size, std::size_t Alignment = alignof(std::max_align_t)>
+  using fast = inline_base<Size, Alignment>;
 };
 
 template<typename Derived> template<typename Pointer> class impl_ptr<Derived>::base {
@@ -46,6 +58,54 @@ public:
   void swap(Derived& other) { impl.swap(other.impl); }
 };
 
+template<typename Derived> template<std::size_t Size, std::size_t Alignment>
+class impl_ptr<Derived>::inline_base {
+  std::aligned_storage_t<Size, Alignment> Storage;
+
+protected:
+  using implementation = typename impl_ptr<Derived>::implementation;
+  using impl_ptr = inline_base;
+
+private:
+  static constexpr void check() {
+    static_assert(sizeof(implementation) <= Size,
+                  "impl_ptr::fast: Size is too small for the implementation");
+    static_assert(Alignment % alignof(implementation) == 0,
+                  "impl_ptr::fast: Alignment is too small for the implementation");
+  }
+  implementation *get() noexcept {
+    return std::launder(reinterpret_cast<implementation *>(&Storage));
+  }
+  implementation const *get() const noexcept {
+    return std::launder(reinterpret_cast<implementation const *>(&Storage));
+  }
+
+protected:
+  template<typename... Args> explicit inline_base(Args&&... args) {
+    check();
+    ::new (&Storage) implementation(std::forward<Args>(args)...);
+  }
+  inline_base(inline_base &&Other)
+  noexcept(std::is_nothrow_move_constructible_v<implementation>) {
+    check();
+    ::new (&Storage) implementation(std::move(*Other.get()));
+  }
+  inline_base &operator=(inline_base &&Other)
+  noexcept(std::is_nothrow_move_constructible_v<implementation>) {
+    if (this != &Other) {
+      get()->~implementation();
+      ::new (&Storage) implementation(std::move(*Other.get()));
+    }
+    return *this;
+  }
+  ~inline_base() { get()->~implementation(); }
+
+  implementation       *operator->()       { return get(); }
+  implementation const *operator->() const { return get(); }
+  implementation       &operator*()       { return *get(); }
+  implementation const &operator*() const { return *get(); }
+};
+
 } // namespace BrlCV
 
 #endif // BrlCV_IMPL_PTR
@@ -1,10 +1,24 @@
 #define GSL_THROW_ON_CONTRACT_VIOLATION
 #include <jack.hpp>
+#include <soundfile.hpp>
+#include <algorithm>
+#include <atomic>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <cmath>
 #include <cstring>
+#include <fstream>
+#include <iomanip>
 #include <jack/jack.h>
 #include <jack/midiport.h>
+#include <mutex>
+#include <optional>
+#include <pthread.h>
+#include <sstream>
 #include <stdexcept>
 #include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace std {
   template<> struct is_error_code_enum<JackStatus>:true_type{};
@@ -64,11 +78,375 @@ std::error_condition make_error_condition(JackStatus e) {
   return { static_cast<int>(e), JACKCategory };
 }
 
+class JACK::MIDIBuffer::Backend {
+public:
+  virtual ~Backend() = default;
+  virtual std::uint32_t eventCount(void *Buffer) const = 0;
+  virtual jack_midi_event_t event(void *Buffer, std::uint32_t Index) const = 0;
+  virtual void clear(void *Buffer) const = 0;
+  virtual std::size_t maxEventSize(void *Buffer) const = 0;
+  virtual jack_midi_data_t *
+  reserve(void *Buffer, jack_nframes_t Time, std::size_t Size) const = 0;
+};
+
+namespace {
+
+class LiveMIDIBackend final : public JACK::MIDIBuffer::Backend {
+public:
+  std::uint32_t eventCount(void *Buffer) const override {
+    return jack_midi_get_event_count(Buffer);
+  }
+  jack_midi_event_t event(void *Buffer, std::uint32_t Index) const override {
+    jack_midi_event_t Event{};
+    jack_midi_event_get(&Event, Buffer, Index);
+    return Event;
+  }
+  void clear(void *Buffer) const override { jack_midi_clear_buffer(Buffer); }
+  std::size_t maxEventSize(void *Buffer) const override {
+    return jack_midi_max_event_size(Buffer);
+  }
+  jack_midi_data_t *
+  reserve(void *Buffer, jack_nframes_t Time, std::size_t Size) const override {
+    return jack_midi_event_reserve(Buffer, Time, Size);
+  }
+};
+
+// Event storage with the same constraints as a JACK MIDI port buffer:
+// fixed capacity and events in non-decreasing time order.
+struct OfflineMIDIBuffer {
+  struct Event { jack_nframes_t Time; std::size_t Offset, Size; };
+  std::vector<Event> Events;
+  std::vector<jack_midi_data_t> Data;
+  std::size_t Used = 0;
+  jack_nframes_t Frames = 0;
+
+  explicit OfflineMIDIBuffer(std::size_t Capacity) : Data(Capacity) {
+    Events.reserve(Capacity);
+  }
+};
+
+class OfflineMIDIBackend final : public JACK::MIDIBuffer::Backend {
+  static OfflineMIDIBuffer &get(void *Buffer) {
+    return *static_cast<OfflineMIDIBuffer *>(Buffer);
+  }
+
+public:
+  std::uint32_t eventCount(void *Buffer) const override {
+    return get(Buffer).Events.size();
+  }
+  jack_midi_event_t event(void *Buffer, std::uint32_t Index) const override {
+    auto &MIDI = get(Buffer);
+    Expects(Index < MIDI.Events.size());
+    auto const &Event = MIDI.Events[Index];
+    return { Event.Time, Event.Size, MIDI.Data.data() + Event.Offset };
+  }
+  void clear(void *Buffer) const override {
+    get(Buffer).Events.clear();
+    get(Buffer).Used = 0;
+  }
+  std::size_t maxEventSize(void *Buffer) const override {
+    return get(Buffer).Data.size() - get(Buffer).Used;
+  }
+  jack_midi_data_t *
+  reserve(void *Buffer, jack_nframes_t Time, std::size_t Size) const override {
+    auto &MIDI = get(Buffer);
+    if (Time >= MIDI.Frames || Size > maxEventSize(Buffer) ||
+        (!MIDI.Events.empty() && Time < MIDI.Events.back().Time)) {
+      return nullptr;
+    }
+    MIDI.Events.push_back({ Time, MIDI.Used, Size });
+    MIDI.Used += Size;
+    return MIDI.Data.data() + MIDI.Events.back().Offset;
+  }
+};
+
+LiveMIDIBackend const LiveMIDI {};
+OfflineMIDIBackend const OfflineMIDI {};
+
+class OfflinePort {
+  static constexpr std::size_t MIDIBufferSize = 32768;
+  std::vector<float> Audio;
+  OfflineMIDIBuffer MIDI;
+  std::optional<BrlCV::SoundFileReader> AudioReader;
+  std::optional<BrlCV::SoundFileWriter> AudioWriter;
+  std::ifstream MIDIReader;
+  std::ofstream MIDIWriter;
+  std::optional<std::tuple<std::uint64_t, std::vector<jack_midi_data_t>>> Pending;
+
+  void readMIDIEvent() {
+    Pending.reset();
+    for (std::string Line; std::getline(MIDIReader, Line);) {
+      std::istringstream Fields(Line);
+      std::uint64_t Frame;
+      if (!(Fields >> Frame)) continue;
+      std::vector<jack_midi_data_t> Bytes;
+      for (unsigned int Byte; Fields >> std::hex >> Byte;) {
+        Bytes.push_back(static_cast<jack_midi_data_t>(Byte));
+      }
+      if (!Bytes.empty()) {
+        Pending.emplace(Frame, std::move(Bytes));
+        return;
+      }
+    }
+  }
+
+public:
+  std::string const Name;
+  bool const IsInput, IsMIDI;
+
+  OfflinePort(JACK::Offline const &Settings, std::string_view Name,
+              std::string_view Type, JackPortFlags Flags)
+  : Audio(Settings.BufferSize), MIDI(MIDIBufferSize)
+  , Name(Name), IsInput(Flags & JackPortIsInput)
+  , IsMIDI(Type == JACK_DEFAULT_MIDI_TYPE)
+  {
+    auto const File = Settings.Files.find(Name);
+    if (File == Settings.Files.end()) return;
+    auto const &Path = File->second;
+    if (IsMIDI && IsInput) {
+      MIDIReader.open(Path);
+      if (!MIDIReader) throw std::runtime_error("Unable to open " + Path);
+      readMIDIEvent();
+    } else if (IsMIDI) {
+      MIDIWriter.open(Path, std::ios::trunc);
+      if (!MIDIWriter) throw std::runtime_error("Unable to create " + Path);
+    } else if (IsInput) {
+      AudioReader.emplace(Path);
+      if (AudioReader->sampleRate() != 0 &&
+          AudioReader->sampleRate() != Settings.SampleRate) {
+        throw std::runtime_error(
+          Path + ": Sample rate " + std::to_string(AudioReader->sampleRate()) +
+          " does not match " + std::to_string(Settings.SampleRate)
+        );
+      }
+    } else {
+      AudioWriter.emplace(Path, Settings.SampleRate);
+    }
+  }
+
+  bool connected() const {
+    return AudioReader || AudioWriter || MIDIReader.is_open() || MIDIWriter.is_open();
+  }
+
+  void *buffer(std::uint32_t FrameCount) {
+    Expects(FrameCount <= Audio.size());
+    if (IsMIDI) {
+      MIDI.Frames = FrameCount;
+      return &MIDI;
+    }
+    return Audio.data();
+  }
+
+  // Fill input buffers for the cycle starting at Frame.  Returns false once
+  // a file backed input has nothing left to deliver.
+  bool prepare(std::uint64_t Frame, std::uint32_t FrameCount) {
+    MIDI.Frames = FrameCount;
+    if (!IsInput) return false;
+    if (!IsMIDI) {
+      if (!AudioReader) {
+        std::fill_n(Audio.begin(), FrameCount, 0.0F);
+        return false;
+      }
+      return AudioReader->read(gsl::span<float>(Audio.data(), FrameCount)) > 0;
+    }
+    OfflineMIDI.clear(&MIDI);
+    bool Delivered = Pending.has_value();
+    while (Pending && std::get<0>(*Pending) < Frame + FrameCount) {
+      auto const &[Time, Bytes] = *Pending;
+      auto const Offset = Time > Frame ? Time - Frame : 0;
+      if (auto Data = OfflineMIDI.reserve(&MIDI, Offset, Bytes.size())) {
+        std::copy(Bytes.begin(), Bytes.end(), Data);
+      }
+      readMIDIEvent();
+    }
+    return Delivered;
+  }
+
+  // Write output buffers of the cycle starting at Frame
+  void flush(std::uint64_t Frame, std::uint32_t FrameCount) {
+    if (IsInput) return;
+    if (AudioWriter) {
+      AudioWriter->write(gsl::span<float const>(Audio.data(), FrameCount));
+    }
+    if (MIDIWriter.is_open()) {
+      for (auto const &Event: MIDI.Events) {
+        MIDIWriter << std::dec << Frame + Event.Time << std::hex << std::uppercase;
+        for (std::size_t I = 0; I < Event.Size; ++I) {
+          MIDIWriter << ' ' << std::setw(2) << std::setfill('0')
+                     << static_cast<unsigned int>(MIDI.Data[Event.Offset + I]);
+        }
+        MIDIWriter << '\n';
+      }
+    }
+  }
+};
+
+// Drives the process callback of a client without a JACK server
+class OfflineEngine {
+  std::vector<OfflinePort *> Ports;
+  std::mutex Mutex;
+  std::thread Thread;
+  std::atomic<bool> Running{false};
+  std::uint64_t Frame = 0;
+
+  void run() {
+    while (Running) {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (Settings.Frames && Frame >= *Settings.Frames) break;
+      bool Inputs = false, Delivered = false;
+      for (auto Port: Ports) {
+        Delivered |= Port->prepare(Frame, Settings.BufferSize);
+        Inputs |= Port->IsInput && Port->connected();
+      }
+      if (!Settings.Frames && Inputs && !Delivered) break;
+      if (Process(Settings.BufferSize, Argument) != 0) break;
+      for (auto Port: Ports) Port->flush(Frame, Settings.BufferSize);
+      Frame += Settings.BufferSize;
+    }
+    Running = false;
+  }
+
+public:
+  std::string const Name;
+  JACK::Offline const Settings;
+  JackProcessCallback Process = nullptr;
+  void *Argument = nullptr;
+
+  OfflineEngine(std::string Name, JACK::Offline Settings)
+  : Name(std::move(Name)), Settings(std::move(Settings))
+  {
+    Expects(this->Settings.SampleRate > 0);
+    Expects(this->Settings.BufferSize > 0);
+  }
+  ~OfflineEngine() { stop(); }
+
+  std::unique_ptr<OfflinePort>
+  registerPort(std::string_view Name, std::string_view Type, JackPortFlags Flags) {
+    auto Port = std::make_unique<OfflinePort>(Settings, Name, Type, Flags);
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Ports.push_back(Port.get());
+    return Port;
+  }
+  void unregisterPort(OfflinePort *Port) {
+    std::lock_guard<std::mutex> Lock(Mutex);
+    Ports.erase(std::remove(Ports.begin(), Ports.end(), Port), Ports.end());
+  }
+
+  void start() {
+    if (Thread.joinable()) return;
+    if (!Settings.Frames) {
+      std::lock_guard<std::mutex> Lock(Mutex);
+      if (std::none_of(Ports.begin(), Ports.end(), [](auto Port) {
+            return Port->IsInput && Port->connected();
+          })) {
+        throw std::runtime_error("Offline client without input files needs a frame limit");
+      }
+    }
+    Running = true;
+    Thread = std::thread(&OfflineEngine::run, this);
+  }
+  void stop() {
+    Running = false;
+    wait();
+  }
+  void wait() {
+    if (Thread.joinable()) Thread.join();
+  }
+};
+
+// Wraps the process callback of a client to time each cycle
+class Telemetry {
+  JackProcessCallback const Process;
+  void *const Argument;
+  jack_client_t *const Handle;
+  boost::lockfree::spsc_queue<JACK::CycleTiming> Queue;
+  std::vector<JACK::CycleTiming> History;
+  std::size_t Next = 0, Recorded = 0;
+  std::atomic<std::size_t> Dropped{0};
+
+public:
+  std::atomic<std::uint32_t> XRuns{0};
+
+  Telemetry(JackProcessCallback Process, void *Argument, jack_client_t *Handle,
+            std::size_t Capacity)
+  : Process(Process), Argument(Argument), Handle(Handle)
+  , Queue(Capacity), History(Capacity) {}
+
+  int process(jack_nframes_t FrameCount) {
+    auto const Start = std::chrono::steady_clock::now();
+    auto const Result = Process(FrameCount, Argument);
+    auto const Stop = std::chrono::steady_clock::now();
+    if (!Queue.push({
+          Start, Stop - Start, FrameCount,
+          Handle != nullptr ? jack_cpu_load(Handle) : 0.0F,
+          XRuns.load(std::memory_order_relaxed)
+        })) {
+      Dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return Result;
+  }
+
+  void poll() {
+    Queue.consume_all([this](JACK::CycleTiming const &Cycle) {
+      History[Next] = Cycle;
+      Next = (Next + 1) % History.size();
+      Recorded = std::min(Recorded + 1, History.size());
+    });
+  }
+
+  JACK::TimingSummary summary(unsigned int SampleRate) {
+    poll();
+
+    JACK::TimingSummary Summary;
+    Summary.Cycles = Recorded;
+    Summary.Dropped = Dropped.load(std::memory_order_relaxed);
+    Summary.XRuns = XRuns.load(std::memory_order_relaxed);
+    if (Recorded == 0) return Summary;
+
+    std::vector<std::chrono::nanoseconds> Durations;
+    Durations.reserve(Recorded);
+    std::chrono::nanoseconds Total{};
+    for (std::size_t I = 0; I < Recorded; ++I) {
+      auto const &Cycle = History[I];
+      Durations.push_back(Cycle.Duration);
+      Total += Cycle.Duration;
+      Summary.MeanCPULoad += Cycle.CPULoad / Recorded;
+      Summary.MaxCPULoad = std::max(Summary.MaxCPULoad, Cycle.CPULoad);
+      Summary.MaxBudget = std::max(
+        Summary.MaxBudget,
+        Cycle.Duration.count() * 1e-9 * SampleRate / Cycle.Frames
+      );
+    }
+    std::sort(Durations.begin(), Durations.end());
+    auto percentile = [&](double P) {
+      auto const Rank = static_cast<std::size_t>(std::ceil(P * Recorded));
+      return Durations[std::clamp<std::size_t>(Rank, 1, Recorded) - 1];
+    };
+    Summary.Min = Durations.front();
+    Summary.Max = Durations.back();
+    Summary.Mean = Total / Recorded;
+    Summary.P50 = percentile(0.5);
+    Summary.P90 = percentile(0.9);
+    Summary.P99 = percentile(0.99);
+    Summary.P999 = percentile(0.999);
+
+    return Summary;
+  }
+};
+
+} // namespace
+
 template<> struct BrlCV::impl_ptr<JACK::Client>::implementation {
-  jack_client_t *const Client;
-    
-  explicit implementation(std::string Name)
-  : Client([&] {
+  jack_client_t *Client;
+  std::unique_ptr<OfflineEngine> Offline;
+  std::unique_ptr<Telemetry> Timing;
+  // The client's own process callback, which Timing wraps when enabled
+  JackProcessCallback Process = nullptr;
+  void *Argument = nullptr;
+
+  implementation(std::string Name, std::optional<JACK::Offline> Backend)
+  : Client([&]() -> jack_client_t * {
+      if (Backend) return nullptr;
       jack_status_t Status;
       auto Handle = jack_client_open(Name.c_str(), JackNoStartServer, &Status);
       if (Handle == nullptr) {
@@ -76,29 +454,123 @@ template<> struct BrlCV::impl_ptr<JACK::Client>::implementation {
       }
       return Handle;
     }())
+  , Offline(Backend ? std::make_unique<OfflineEngine>(std::move(Name), std::move(*Backend)) : nullptr)
   {}
-  ~implementation() { jack_client_close(Client); }
+  implementation(implementation &&Other) noexcept
+  : Client(std::exchange(Other.Client, nullptr))
+  , Offline(std::move(Other.Offline)), Timing(std::move(Other.Timing))
+  , Process(Other.Process), Argument(Other.Argument)
+  {}
+  ~implementation() {
+    if (Client != nullptr) jack_client_close(Client);
+  }
+
+  void setProcessCallback(JackProcessCallback Callback, void *Argument) {
+    if (!Timing) {
+      Process = Callback;
+      this->Argument = Argument;
+    }
+    if (Offline) {
+      Offline->Process = Callback;
+      Offline->Argument = Argument;
+    } else if (jack_set_process_callback(Client, Callback, Argument) != 0) {
+      throw std::runtime_error("JACK: Unable to set process callback");
+    }
+  }
 };
 
 template<> struct BrlCV::impl_ptr<JACK::Port>::implementation {
   JACK::Client &Client;
-  jack_port_t * const Port;
+  jack_port_t *Port;
+  std::unique_ptr<OfflinePort> Offline;
   
   implementation(JACK::Client &Client, std::string_view Name, std::string_view Type, JackPortFlags Flags)
   : Client(Client)
-  , Port(jack_port_register(Client->Client, Name.data(), Type.data(), Flags, 0))
+  , Port(Client->Offline ? nullptr : jack_port_register(Client->Client, Name.data(), Type.data(), Flags, 0))
+  , Offline(Client->Offline ? Client->Offline->registerPort(Name, Type, Flags) : nullptr)
   {
-    if (Port == nullptr) {
+    if (Port == nullptr && Offline == nullptr) {
       throw std::runtime_error("Failed to register port");
     }
   }
-  ~implementation() { jack_port_unregister(Client->Client, Port); }
+  implementation(implementation &&Other) noexcept
+  : Client(Other.Client), Port(std::exchange(Other.Port, nullptr))
+  , Offline(std::move(Other.Offline))
+  {}
+  ~implementation() {
+    if (Port != nullptr) {
+      jack_port_unregister(Client->Client, Port);
+    } else if (Offline) {
+      Client->Offline->unregisterPort(Offline.get());
+    }
+  }
 
-  auto getBuffer(int FrameCount) { return jack_port_get_buffer(Port, FrameCount); }
+  std::string name() const {
+    if (Port != nullptr) return jack_port_name(Port);
+    return Client->Offline->Name + ':' + Offline->Name;
+  }
+  std::size_t connections() const {
+    if (Port != nullptr) return jack_port_connected(Port);
+    return Offline->connected() ? 1 : 0;
+  }
+
+  auto getBuffer(std::uint32_t FrameCount) {
+    return Port != nullptr ? jack_port_get_buffer(Port, FrameCount) : Offline->buffer(FrameCount);
+  }
+  JACK::MIDIBuffer::Backend const &midiBackend() const {
+    if (Port != nullptr) return LiveMIDI;
+    return OfflineMIDI;
+  }
+  std::tuple<std::uint32_t, std::uint32_t> latencyRange(JackLatencyCallbackMode Mode) const {
+    jack_latency_range_t Range{};
+    if (Port != nullptr) jack_port_get_latency_range(Port, Mode, &Range);
+    return { Range.min, Range.max };
+  }
+};
+
+template<> struct BrlCV::impl_ptr<JACK::RealtimeThread>::implementation {
+  std::function<void()> Body;
+  std::optional<jack_native_thread_t> Native;
+  std::thread Thread;
+
+  implementation(JACK::Client &Client, std::function<void()> Body) : Body(std::move(Body)) {
+    auto const Handle = Client->Client;
+    if (Handle != nullptr && jack_is_realtime(Handle)) {
+      jack_native_thread_t Created;
+      if (jack_client_create_thread(Handle, &Created, jack_client_real_time_priority(Handle),
+                                    1, &implementation::run, this) != 0) {
+        throw std::runtime_error("JACK: Unable to create real-time thread");
+      }
+      Native = Created;
+    } else {
+      Thread = std::thread(&implementation::run, this);
+    }
+  }
+  ~implementation() {
+    if (Native) {
+      pthread_join(*Native, nullptr);
+    } else if (Thread.joinable()) {
+      Thread.join();
+    }
+  }
+
+  static void *run(void *Self) {
+    static_cast<implementation *>(Self)->Body();
+    return nullptr;
+  }
 };
 
 namespace JACK {
 
+RealtimeThread::RealtimeThread(Client &C, std::function<void()> Body)
+: impl_ptr(C, std::move(Body))
+{}
+
+RealtimeThread::RealtimeThread(RealtimeThread &&) noexcept = default;
+RealtimeThread &RealtimeThread::operator=(RealtimeThread &&) noexcept = default;
+
+RealtimeThread::~RealtimeThread() = default;
+
 Port::Port(Client &C, std::string_view N, std::string_view T, bool IsInput)
 : impl_ptr(C, N, T, static_cast<JackPortFlags>(IsInput ? JackPortIsInput : JackPortIsOutput))
 {}
@@ -109,11 +581,11 @@ Port &Port::operator=(Port &&) noexcept = default;
 Port::~Port() = default;
 
 std::string Port::name() const {
-  return jack_port_name((*this)->Port);
+  return (*this)->name();
 }
 
 std::size_t Port::connections() const {
-  return jack_port_connected((*this)->Port);
+  return (*this)->connections();
 }
 
 AudioIn::AudioIn(JACK::Client &Client, std::string_view Name)
@@ -125,9 +597,7 @@ gsl::span<float const> AudioIn::buffer(std::int32_t FrameCount) {
 }
     
 std::tuple<std::uint32_t, std::uint32_t> AudioIn::latencyRange() const {
-  jack_latency_range_t Range{};
-  jack_port_get_latency_range((*this)->Port, JackCaptureLatency, &Range);
-  return { Range.min, Range.max };
+  return (*this)->latencyRange(JackCaptureLatency);
 }
 
 AudioOut::AudioOut(JACK::Client &Client, std::string_view Name)
@@ -139,67 +609,65 @@ gsl::span<float> AudioOut::buffer(std::int32_t FrameCount) {
 }
 
 std::tuple<std::uint32_t, std::uint32_t> AudioOut::latencyRange() const {
-  jack_latency_range_t Range{};
-  jack_port_get_latency_range((*this)->Port, JackPlaybackLatency, &Range);
-  return { Range.min, Range.max };
+  return (*this)->latencyRange(JackPlaybackLatency);
+}
+
+MIDIBuffer::MIDIBuffer(void *Buffer, Backend const &Implementation,
+                       std::uint32_t FrameCount, void (MIDIBuffer::*Prepare)())
+: Buffer(Buffer), Implementation(Implementation), Frames(FrameCount) {
+  Expects(Buffer != nullptr);
+  Expects(FrameCount > 0);
+  if (Prepare != nullptr) {
+    (this->*Prepare)();
+  }
+  EventCount = Implementation.eventCount(Buffer);
 }
 
 void MIDIBuffer::clear() {
-  jack_midi_clear_buffer(Buffer);
+  Implementation.clear(Buffer);
+  EventCount = 0;
 }
 
 MIDIBuffer::Index &MIDIBuffer::Index::operator=(MIDI::SongPositionPointer const &SPP) {
-  std::copy(SPP.begin(), SPP.end(), Buffer.reserve(Offset, SPP.size()).begin());
-    
+  if (auto const Data = Buffer.reserve(Offset, SPP.size()); !Data.empty()) {
+    std::copy(SPP.begin(), SPP.end(), Data.begin());
+  }
+
   return *this;
 }
 
 MIDIBuffer::Index &MIDIBuffer::Index::operator=(MIDI::SystemRealTimeMessage Message) {
-  Buffer.reserve<1>(Offset)[0] = static_cast<std::byte>(Message);
-            
-  return *this;
-}
+  if (auto const Data = Buffer.reserve(Offset, 1); !Data.empty()) {
+    Data[0] = static_cast<std::byte>(Message);
+  }
 
-gsl::span<std::byte>
-MIDIBuffer::reserve(std::uint32_t FrameOffset, std::uint32_t Size) {
-  Expects(jack_midi_max_event_size(Buffer) >= Size);
-  return {
-    reinterpret_cast<std::byte *>(
-      jack_midi_event_reserve(Buffer, FrameOffset, Size)
-    ), Size
-  };
+  return *this;
 }
 
-MIDIBuffer::Iterator::const_reference MIDIBuffer::Iterator::operator*() const
-{
-  jack_midi_event_t Event;
-  jack_midi_event_get(&Event, Buffer.Buffer, Offset);
-  gsl::span<std::byte> Span(reinterpret_cast<std::byte*>(Event.buffer), Event.size);
-
-  CurrentEvent = std::nullopt;
-
-  if (!Span.empty()) {
-    if (Span[0] == std::byte(0XF2)) {
-      CurrentEvent = { Event.time, MIDI::SongPositionPointer(Span) };
-    } else if (Span[0] >= static_cast<std::byte>(MIDI::SystemRealTimeMessage::Clock)) {
-      CurrentEvent = { Event.time, MIDI::SystemRealTimeMessage(Span[0]) };
-    } else {
-      CurrentEvent = { Event.time, Span };
-    }
+MIDIBuffer::Index &MIDIBuffer::Index::operator=(MIDI::Message const &Message) {
+  if (auto const Data = Buffer.reserve(Offset, Message.size()); !Data.empty()) {
+    std::copy(Message.begin(), Message.end(), Data.begin());
   }
 
-  Expects(CurrentEvent.has_value());
-
-  return CurrentEvent.value();
+  return *this;
 }
 
-MIDIBuffer::Iterator MIDIBuffer::begin() const {
-  return { *this, 0, jack_midi_get_event_count(Buffer) };
+gsl::span<std::byte>
+MIDIBuffer::reserve(std::uint32_t FrameOffset, std::uint32_t Size) {
+  if (Implementation.maxEventSize(Buffer) < Size) return {};
+  auto const Data = Implementation.reserve(Buffer, FrameOffset, Size);
+  if (Data == nullptr) return {};
+  EventCount += 1;
+  return { reinterpret_cast<std::byte *>(Data), Size };
 }
 
-MIDIBuffer::Iterator MIDIBuffer::end() const {
-  auto const EventCount = jack_midi_get_event_count(Buffer);
-  return { *this, EventCount, EventCount };
+MIDIBuffer::Event MIDIBuffer::event(std::uint32_t Index) const {
+  Expects(Index < EventCount);
+  auto const Event = Implementation.event(Buffer, Index);
+  return {
+    Event.time, { reinterpret_cast<std::byte const *>(Event.buffer),
+                  static_cast<std::ptrdiff_t>(Event.size) }
+  };
 }
 
 MIDIOut::MIDIOut(JACK::Client &Client, std::string_view Name)
@@ -207,7 +675,10 @@ MIDIOut::MIDIOut(JACK::Client &Client, std::string_view Name)
 {}
 
 MIDIBuffer MIDIOut::buffer(std::uint32_t FrameCount) {
-  return { (*this)->getBuffer(FrameCount), FrameCount, &MIDIBuffer::clear };
+  return {
+    (*this)->getBuffer(FrameCount), (*this)->midiBackend(), FrameCount,
+    &MIDIBuffer::clear
+  };
 }
 
 MIDIIn::MIDIIn(JACK::Client &Client, std::string_view Name)
@@ -215,7 +686,7 @@ MIDIIn::MIDIIn(JACK::Client &Client, std::string_view Name)
 {}
 
 MIDIBuffer const MIDIIn::buffer(std::uint32_t FrameCount) {
-  return { (*this)->getBuffer(FrameCount), FrameCount };
+  return { (*this)->getBuffer(FrameCount), (*this)->midiBackend(), FrameCount };
 }
 
 extern "C" int process(jack_nframes_t nframes, void *instance)
@@ -223,9 +694,51 @@ extern "C" int process(jack_nframes_t nframes, void *instance)
   return static_cast<Client *>(instance)->process(nframes);
 }
 
-Client::Client(std::string Name) : impl_ptr(std::move(Name))
+extern "C" int timedProcess(jack_nframes_t nframes, void *instance)
 {
-  jack_set_process_callback((*this)->Client, &JACK::process, this);
+  return static_cast<Telemetry *>(instance)->process(nframes);
+}
+
+extern "C" int bufferSizeChanged(jack_nframes_t nframes, void *instance)
+{
+  return static_cast<Client *>(instance)->bufferSizeChanged(nframes);
+}
+
+extern "C" int countXRun(void *instance)
+{
+  static_cast<Telemetry *>(instance)->XRuns.fetch_add(1, std::memory_order_relaxed);
+  return 0;
+}
+
+std::ostream &operator<<(std::ostream &Out, TimingSummary const &Summary) {
+  auto us = [](std::chrono::nanoseconds Duration) {
+    return std::chrono::duration<double, std::micro>(Duration).count();
+  };
+  Out << "cycles=" << Summary.Cycles << " xruns=" << Summary.XRuns
+      << " dropped=" << Summary.Dropped
+      << " min=" << us(Summary.Min) << "us mean=" << us(Summary.Mean)
+      << "us p50=" << us(Summary.P50) << "us p90=" << us(Summary.P90)
+      << "us p99=" << us(Summary.P99) << "us p99.9=" << us(Summary.P999)
+      << "us max=" << us(Summary.Max)
+      << "us budget=" << Summary.MaxBudget * 100 << '%'
+      << " cpu=" << Summary.MeanCPULoad << "%/" << Summary.MaxCPULoad << '%';
+  return Out;
+}
+
+Client::Client(std::string Name, std::optional<Offline> Backend)
+: impl_ptr(std::move(Name), std::move(Backend))
+{
+  (*this)->setProcessCallback(&JACK::process, this);
+  if ((*this)->Client != nullptr &&
+      jack_set_buffer_size_callback((*this)->Client, &JACK::bufferSizeChanged, this) != 0) {
+    throw std::runtime_error("JACK: Unable to set buffer size callback");
+  }
+}
+
+void Client::setProcessCallback(ProcessCallback Callback, void *Argument) {
+  Expects(Callback != nullptr);
+  Expects(!(*this)->Timing);
+  (*this)->setProcessCallback(Callback, Argument);
 }
 
 Client::Client(Client &&) noexcept = default;
@@ -233,11 +746,23 @@ Client &Client::operator=(Client &&) noexcept = default;
 
 Client::~Client() = default;
 
+std::string Client::name() const {
+  if ((*this)->Offline) return (*this)->Offline->Name;
+  return jack_get_client_name((*this)->Client);
+}
+
 unsigned int Client::sampleRate() const {
+  if ((*this)->Offline) return (*this)->Offline->Settings.SampleRate;
   return jack_get_sample_rate((*this)->Client);
 }
 
+std::uint32_t Client::bufferSize() const {
+  if ((*this)->Offline) return (*this)->Offline->Settings.BufferSize;
+  return jack_get_buffer_size((*this)->Client);
+}
+
 bool Client::isRealtime() const {
+  if ((*this)->Offline) return false;
   return jack_is_realtime((*this)->Client) == 1;
 }
 
@@ -257,7 +782,45 @@ MIDIOut Client::createMIDIOut(std::string_view Name) {
   return { *this, Name };
 }
 
+namespace {
+
+template<typename PortType, typename Create>
+std::vector<PortType> numberedPorts(std::string_view Prefix, std::size_t Count, Create create) {
+  std::vector<PortType> Ports;
+  Ports.reserve(Count);
+  for (std::size_t I = 0; I < Count; ++I) {
+    Ports.push_back(create(std::string(Prefix) + std::to_string(I + 1)));
+  }
+  return Ports;
+}
+
+} // namespace
+
+AudioInArray Client::createAudioIns(std::string_view Prefix, std::size_t Count) {
+  return AudioInArray(numberedPorts<AudioIn>(Prefix, Count, [this](std::string const &Name) {
+    return createAudioIn(Name);
+  }));
+}
+
+AudioOutArray Client::createAudioOuts(std::string_view Prefix, std::size_t Count) {
+  return AudioOutArray(numberedPorts<AudioOut>(Prefix, Count, [this](std::string const &Name) {
+    return createAudioOut(Name);
+  }));
+}
+
+MIDIOutArray Client::createMIDIOuts(std::string_view Prefix, std::size_t Count) {
+  return MIDIOutArray(numberedPorts<MIDIOut>(Prefix, Count, [this](std::string const &Name) {
+    return createMIDIOut(Name);
+  }));
+}
+
+RealtimeThread Client::createRealtimeThread(std::function<void()> Body) {
+  Expects(Body);
+  return { *this, std::move(Body) };
+}
+
 void Client::activate() {
+  if ((*this)->Offline) return (*this)->Offline->start();
   auto status = jack_activate((*this)->Client);
   if (status < 0) {
     throw std::system_error(-status, std::generic_category());
@@ -265,13 +828,49 @@ void Client::activate() {
 }
 
 void Client::deactivate() {
+  if ((*this)->Offline) return (*this)->Offline->stop();
   auto Status = jack_deactivate((*this)->Client);
   if (Status != 0) {
     throw std::system_error(Status, std::generic_category());
   }
 }
 
+void Client::wait() {
+  if (!(*this)->Offline) {
+    throw std::logic_error("JACK: Only offline clients run to completion");
+  }
+  (*this)->Offline->wait();
+}
+
+void Client::enableTiming(std::size_t History) {
+  Expects(History > 0);
+  auto Timing = std::make_unique<Telemetry>((*this)->Process, (*this)->Argument,
+                                            (*this)->Client, History);
+  (*this)->setProcessCallback(&JACK::timedProcess, Timing.get());
+  if ((*this)->Client != nullptr &&
+      jack_set_xrun_callback((*this)->Client, &JACK::countXRun, Timing.get()) != 0) {
+    throw std::runtime_error("JACK: Unable to set xrun callback");
+  }
+  (*this)->Timing = std::move(Timing);
+}
+
+void Client::pollTiming() {
+  if (!(*this)->Timing) {
+    throw std::logic_error("JACK: Timing was not enabled");
+  }
+  (*this)->Timing->poll();
+}
+
+TimingSummary Client::timing() {
+  if (!(*this)->Timing) {
+    throw std::logic_error("JACK: Timing was not enabled");
+  }
+  return (*this)->Timing->summary(sampleRate());
+}
+
 void Client::connect(std::string_view From, std::string_view To) {
+  // Offline ports are wired to files, not to each other
+  if ((*this)->Offline) return;
   auto Result = jack_connect((*this)->Client, From.data(), To.data());
   if (Result != 0 && Result != EEXIST) {
     throw std::runtime_error("JACK: Unable to connect port");
@@ -1,9 +1,19 @@
 #if !defined(BrlCV_JACK_HPP)
 #define BrlCV_JACK_HPP
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <iterator>
+#include <map>
+#include <optional>
 #include <string>
 #include <string_view>
-#include <variant>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <gsl/gsl>
 
@@ -14,7 +24,20 @@ namespace JACK {
 
 class Client;
 
-class Port : protected BrlCV::impl_ptr<Port>::unique {
+// Runs a client without a JACK server.  Ports are backed by the files named
+// in Files (keyed by short port name): audio inputs read WAV or headerless
+// 32 bit float files, audio outputs are written in the same formats, and
+// MIDI ports use text files with one "<frame> <hex bytes...>" event per line.
+// process() is called from a normal thread as fast as possible until every
+// file backed input is exhausted or Frames have been processed.
+struct Offline {
+  unsigned int SampleRate = 48000;
+  std::uint32_t BufferSize = 256;
+  std::map<std::string, std::string, std::less<>> Files;
+  std::optional<std::uint64_t> Frames;
+};
+
+class Port : protected BrlCV::impl_ptr<Port>::fast<4 * sizeof(void *), alignof(void *)> {
 protected:
   Port(Client &, std::string_view N, std::string_view T, bool IsInput);
 
@@ -55,20 +78,19 @@ public:
 };
 
 class MIDIBuffer {
+public:
+  class Backend;
+
+private:
   void *Buffer;
+  Backend const &Implementation;
   std::uint32_t const Frames;
+  std::uint32_t EventCount = 0;
   friend class MIDIOut;
   friend class MIDIIn;
 
-  MIDIBuffer(void *Buffer, std::uint32_t FrameCount,
-             void (MIDIBuffer::*Prepare)() = nullptr)
-  : Buffer(Buffer), Frames(FrameCount) {
-    Expects(Buffer != nullptr);
-    Expects(FrameCount > 0);
-    if (Prepare != nullptr) {
-      (this->*Prepare)();
-    }
-  }
+  MIDIBuffer(void *Buffer, Backend const &Implementation,
+             std::uint32_t FrameCount, void (MIDIBuffer::*Prepare)() = nullptr);
 
 public:
   class Index {
@@ -81,50 +103,81 @@ public:
   public:
     Index &operator=(MIDI::SongPositionPointer const &);
     Index &operator=(MIDI::SystemRealTimeMessage);
+    Index &operator=(MIDI::Message const &);
   };
   void clear();
+  // Empty if the event does not fit, assignments through Index drop it then
   gsl::span<std::byte> reserve(std::uint32_t FrameOffset, std::uint32_t Size);
   template<std::uint32_t Size>
-  gsl::span<std::byte, Size> reserve(std::uint32_t FrameOffset) {
-    return reserve(FrameOffset, Size);
+  std::optional<gsl::span<std::byte, Size>> reserve(std::uint32_t FrameOffset) {
+    auto const Data = reserve(FrameOffset, Size);
+    if (Data.empty()) return std::nullopt;
+    return gsl::span<std::byte, Size>(Data.data(), Size);
   }
   Index operator[](std::uint32_t FrameOffset) {
     Expects(FrameOffset < Frames);
     return { *this, FrameOffset };
   }
-  class Iterator {
+
+  // View of one event, pointing into the port buffer
+  class Event {
+    std::uint32_t Time = 0;
+    gsl::span<std::byte const> Bytes;
+
   public:
-    using value_type = std::tuple<std::uint32_t, std::variant<
-      MIDI::SongPositionPointer, MIDI::SystemRealTimeMessage, gsl::span<std::byte>
-    >>;
-  private:
-    MIDIBuffer const &Buffer;
-    std::uint32_t Offset, Size;
-    mutable std::optional<value_type> CurrentEvent;
+    Event() = default;
+    Event(std::uint32_t Time, gsl::span<std::byte const> Bytes) noexcept
+    : Time(Time), Bytes(Bytes) {}
+
+    std::uint32_t time() const noexcept { return Time; }
+    std::byte status() const {
+      Expects(!Bytes.empty());
+      return Bytes[0];
+    }
+    gsl::span<std::byte const> payload() const {
+      Expects(!Bytes.empty());
+      return Bytes.subspan(1);
+    }
+    gsl::span<std::byte const> bytes() const noexcept { return Bytes; }
+    // Empty for SysEx and malformed events
+    std::optional<MIDI::Message> message() const { return MIDI::decode(Bytes); }
+  };
+  Event event(std::uint32_t Index) const;
+  std::uint32_t size() const noexcept { return EventCount; }
+  bool empty() const noexcept { return EventCount == 0; }
+
+  // Each event is fetched once, when the iterator reaches it
+  class Iterator {
+    MIDIBuffer const *Buffer;
+    std::uint32_t Offset;
+    Event Current;
     friend class MIDIBuffer;
 
-    Iterator(MIDIBuffer const &Buffer, std::uint32_t Offset, std::uint32_t Size)
-    : Buffer(Buffer), Offset(Offset), Size(Size) {}
+    Iterator(MIDIBuffer const &Buffer, std::uint32_t Offset)
+    : Buffer(&Buffer), Offset(Offset) { fetch(); }
+    void fetch() {
+      if (Offset < Buffer->EventCount) Current = Buffer->event(Offset);
+    }
   public:
     using iterator_category = std::forward_iterator_tag;
-    using reference = value_type&;
-    using const_reference = value_type const &;
-    using pointer = value_type*;
-    using const_pointer = value_type const *;
+    using value_type = Event;
+    using difference_type = std::ptrdiff_t;
+    using reference = value_type const &;
+    using pointer = value_type const *;
 
     friend bool operator==(Iterator const &Lhs, Iterator const &Rhs) {
-      return (Lhs.Offset == Rhs.Offset) && (Lhs.Size == Rhs.Size);
+      return Lhs.Offset == Rhs.Offset;
     }
     friend bool operator!=(Iterator const &Lhs, Iterator const &Rhs) {
-      return Lhs.Offset != Rhs.Offset || Lhs.Size != Rhs.Size;
+      return Lhs.Offset != Rhs.Offset;
     }
-    Iterator &operator++() { Offset += 1; return *this; }
+    Iterator &operator++() { Offset += 1; fetch(); return *this; }
     Iterator const operator++(int) { auto Result = *this; ++*this; return Result; }
-    const_reference operator*() const;
-    const_pointer operator->() const { return &**this; }
+    reference operator*() const noexcept { return Current; }
+    pointer operator->() const noexcept { return &Current; }
   };
-  Iterator begin() const;
-  Iterator end() const;
+  Iterator begin() const { return { *this, 0 }; }
+  Iterator end() const { return { *this, EventCount }; }
 };
 
 class MIDIOut : public Port {
@@ -143,26 +196,167 @@ public:
   MIDIBuffer const buffer(std::uint32_t FrameCount);
 };
 
-class Client : BrlCV::impl_ptr<Client>::unique {
+// Ports of one kind registered together as Prefix1..PrefixN.  The derived
+// arrays fetch every buffer with one gather() per cycle into a contiguous
+// array that process() can loop over.
+template<typename PortType> class PortArray {
+protected:
+  std::vector<PortType> Ports;
+
+  explicit PortArray(std::vector<PortType> Ports) : Ports(std::move(Ports)) {}
+
+public:
+  std::size_t size() const noexcept { return Ports.size(); }
+  bool empty() const noexcept { return Ports.empty(); }
+  PortType &operator[](std::size_t Index) { return Ports[Index]; }
+  PortType const &operator[](std::size_t Index) const { return Ports[Index]; }
+  PortType &at(std::size_t Index) { return Ports.at(Index); }
+  PortType const &at(std::size_t Index) const { return Ports.at(Index); }
+  auto begin() const noexcept { return Ports.begin(); }
+  auto end() const noexcept { return Ports.end(); }
+};
+
+class AudioInArray : public PortArray<AudioIn> {
+  std::vector<float const *> Buffers;
+  std::uint32_t Frames = 0;
+  friend class Client;
+
+  explicit AudioInArray(std::vector<AudioIn> Ports)
+  : PortArray(std::move(Ports)), Buffers(size()) {}
+
+public:
+  gsl::span<float const * const> gather(std::uint32_t FrameCount) {
+    for (std::size_t I = 0; I < Ports.size(); ++I) {
+      Buffers[I] = Ports[I].buffer(FrameCount).data();
+    }
+    Frames = FrameCount;
+    return Buffers;
+  }
+  // Of the last gather()
+  gsl::span<float const * const> buffers() const noexcept { return Buffers; }
+  gsl::span<float const> buffer(std::size_t Index) const {
+    return { Buffers[Index], Frames };
+  }
+};
+
+class AudioOutArray : public PortArray<AudioOut> {
+  std::vector<float *> Buffers;
+  std::uint32_t Frames = 0;
+  friend class Client;
+
+  explicit AudioOutArray(std::vector<AudioOut> Ports)
+  : PortArray(std::move(Ports)), Buffers(size()) {}
+
+public:
+  gsl::span<float * const> gather(std::uint32_t FrameCount) {
+    for (std::size_t I = 0; I < Ports.size(); ++I) {
+      Buffers[I] = Ports[I].buffer(FrameCount).data();
+    }
+    Frames = FrameCount;
+    return Buffers;
+  }
+  // Of the last gather()
+  gsl::span<float * const> buffers() const noexcept { return Buffers; }
+  gsl::span<float> buffer(std::size_t Index) const {
+    return { Buffers[Index], Frames };
+  }
+};
+
+class MIDIOutArray : public PortArray<MIDIOut> {
+  std::vector<MIDIBuffer> Buffers;
+  friend class Client;
+
+  explicit MIDIOutArray(std::vector<MIDIOut> Ports) : PortArray(std::move(Ports)) {
+    Buffers.reserve(size());
+  }
+
+public:
+  // Clears every port buffer, as MIDIOut::buffer() does
+  gsl::span<MIDIBuffer> gather(std::uint32_t FrameCount) {
+    Buffers.clear();
+    for (auto &Port: Ports) Buffers.push_back(Port.buffer(FrameCount));
+    return Buffers;
+  }
+  // Of the last gather()
+  MIDIBuffer &buffer(std::size_t Index) { return Buffers[Index]; }
+};
+
+// One process() call as recorded by Client::enableTiming()
+struct CycleTiming {
+  std::chrono::steady_clock::time_point Start;
+  std::chrono::nanoseconds Duration;
+  std::uint32_t Frames;
+  float CPULoad;       // As reported by jack_cpu_load, 0 when offline
+  std::uint32_t XRuns; // Total since timing was enabled
+};
+
+struct TimingSummary {
+  std::size_t Cycles = 0, Dropped = 0;
+  std::uint32_t XRuns = 0;
+  std::chrono::nanoseconds Min{}, Mean{}, Max{}, P50{}, P90{}, P99{}, P999{};
+  float MeanCPULoad = 0, MaxCPULoad = 0;
+  // Largest fraction of a period spent in process()
+  double MaxBudget = 0;
+};
+
+std::ostream &operator<<(std::ostream &, TimingSummary const &);
+
+// Runs Body on a thread with the real-time priority of the client's process
+// thread if JACK runs real-time, on a normal thread otherwise.  Joins on
+// destruction, so Body has to return by then.
+class RealtimeThread : BrlCV::impl_ptr<RealtimeThread>::unique {
+  friend class Client;
+  RealtimeThread(Client &, std::function<void()> Body);
+
+public:
+  ~RealtimeThread();
+  RealtimeThread(RealtimeThread &&) noexcept;
+  RealtimeThread &operator=(RealtimeThread &&) noexcept;
+};
+
+class Client : BrlCV::impl_ptr<Client>::fast<6 * sizeof(void *), alignof(void *)> {
   friend class BrlCV::impl_ptr<JACK::Port>::implementation;
+  friend class BrlCV::impl_ptr<JACK::RealtimeThread>::implementation;
 public:
-  explicit Client(std::string Name);
+  explicit Client(std::string Name, std::optional<Offline> Backend = std::nullopt);
   Client(Client &&) noexcept;
   Client &operator=(Client &&) noexcept;
   Client(const Client &) = delete;
   Client &operator=(const Client &) = delete;
   virtual ~Client();
 
+  // May differ from the requested name if that was taken
+  std::string name() const;
   unsigned int sampleRate() const;
+  // Frames per process() call, until bufferSizeChanged() says otherwise
+  std::uint32_t bufferSize() const;
   bool isRealtime() const;
 
   AudioIn createAudioIn(std::string_view Name);
   AudioOut createAudioOut(std::string_view Name);
   MIDIIn createMIDIIn(std::string_view Name);
   MIDIOut createMIDIOut(std::string_view Name);
+  AudioInArray createAudioIns(std::string_view Prefix, std::size_t Count);
+  AudioOutArray createAudioOuts(std::string_view Prefix, std::size_t Count);
+  MIDIOutArray createMIDIOuts(std::string_view Prefix, std::size_t Count);
+
+  RealtimeThread createRealtimeThread(std::function<void()> Body);
 
   void activate();
   void deactivate();
+  // Block until an offline client has consumed all of its input
+  void wait();
+
+  // Record every process() call in a preallocated lock-free ring and keep
+  // the last History cycles for timing().  Call before activate().
+  void enableTiming(std::size_t History = 8192);
+  // Moves the cycles recorded so far into the history.  Call it at least
+  // every History cycles while active, cycles that do not fit the ring in
+  // between count as dropped.  Not real-time safe, and from the thread
+  // that calls timing().
+  void pollTiming();
+  // Not real-time safe
+  TimingSummary timing();
 
   void connect(std::string_view From, std::string_view To);
   void connect(std::string_view From, AudioIn const &To) {
@@ -174,7 +368,73 @@ public:
   void connect(MIDIOut const &From, std::string_view To) {
     return connect(From.name(), To);
   }
-  virtual int process(int FrameCount) = 0;
+  void connect(std::string_view From, MIDIIn const &To) {
+    return connect(From, To.name());
+  }
+  virtual int process(std::uint32_t FrameCount) = 0;
+  // Called outside the real-time thread, while process() is not running,
+  // before the period size changes.  Rebuild state that depends on it here.
+  virtual int bufferSizeChanged(std::uint32_t /*FrameCount*/) { return 0; }
+
+protected:
+  using ProcessCallback = int (*)(std::uint32_t FrameCount, void *Argument);
+  // Replaces the call of the virtual process(), before enableTiming()
+  void setProcessCallback(ProcessCallback, void *Argument);
+};
+
+// Period size known at compile time, see StaticClient.  The conversion is
+// explicit so that it never selects process(std::uint32_t) by accident.
+template<std::uint32_t Size> struct FixedFrames {
+  static constexpr std::uint32_t value = Size;
+  explicit constexpr operator std::uint32_t() const noexcept { return Size; }
+};
+
+namespace Detail {
+
+template<typename Derived, std::uint32_t Size, typename = void>
+struct HasFixedProcess : std::false_type {};
+template<typename Derived, std::uint32_t Size>
+struct HasFixedProcess<Derived, Size, std::void_t<
+  decltype(std::declval<Derived &>().process(FixedFrames<Size>()))
+>> : std::true_type {};
+
+} // namespace Detail
+
+// Client whose JACK callback calls Derived::process directly, so the
+// compiler sees one function from the callback down into the DSP instead
+// of a virtual call.  For the common period sizes a public
+//
+//   template<std::uint32_t Size> int process(JACK::FixedFrames<Size>);
+//
+// is called instead if Derived has it, everything else goes to
+// process(std::uint32_t), which Derived must still override.
+template<typename Derived> class StaticClient : public Client {
+  template<std::uint32_t Size> static int fixed(Derived &Self) {
+    if constexpr (Detail::HasFixedProcess<Derived, Size>::value) {
+      return Self.process(FixedFrames<Size>());
+    } else {
+      return Self.Derived::process(Size);
+    }
+  }
+  static int dispatch(std::uint32_t FrameCount, void *Instance) {
+    auto &Self = *static_cast<Derived *>(Instance);
+    switch (FrameCount) {
+    case 32: return fixed<32>(Self);
+    case 64: return fixed<64>(Self);
+    case 128: return fixed<128>(Self);
+    case 256: return fixed<256>(Self);
+    case 512: return fixed<512>(Self);
+    case 1024: return fixed<1024>(Self);
+    default: return Self.Derived::process(FrameCount);
+    }
+  }
+
+protected:
+  explicit StaticClient(std::string Name, std::optional<Offline> Backend = std::nullopt)
+  : Client(std::move(Name), std::move(Backend))
+  {
+    setProcessCallback(&dispatch, static_cast<Derived *>(this));
+  }
 };
 
 } // namespace JACK
@@ -0,0 +1,146 @@
+#if !defined(BrlCV_MESSAGEBUS_HPP)
+#define BrlCV_MESSAGEBUS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <gsl/gsl>
+
+#include <notifier.hpp>
+
+namespace BrlCV {
+
+// What send() does with a message that does not fit
+enum class Backpressure {
+  // Discards it and counts it in dropped(); never waits, so this is the
+  // policy for messages sent from the real-time thread
+  Drop,
+  // Waits until the consumer has made room; never use it on the real-time
+  // thread, and only while the consumer keeps draining.  Offline clients
+  // run process() on a normal thread and can use it to lose nothing.
+  Block
+};
+
+namespace Detail {
+
+template<typename> struct IsVariant : std::false_type {};
+template<typename... Types> struct IsVariant<std::variant<Types...>> : std::true_type {};
+
+} // namespace Detail
+
+// Single producer, single consumer queue of Message, typically a
+// std::variant of message structs, in storage allocated up front.  Both
+// sides only touch their own index and read the other, so send() and
+// drain() take no locks and do not allocate as long as assigning a Message
+// does not.  drain() hands out everything that is pending with a single
+// index update.  Pair it with a Notifier to wake the consumer, once per
+// cycle rather than once per message.
+template<typename Message> class MessageQueue {
+  static constexpr std::size_t CacheLine = 64;
+
+  std::unique_ptr<Message[]> Slots;
+  std::size_t const Mask;
+  Backpressure const Policy;
+  // Written by the producer
+  alignas(CacheLine) std::atomic<std::size_t> Head { 0 };
+  std::atomic<std::uint64_t> Dropped { 0 };
+  std::atomic<std::size_t> HighWater { 0 };
+  // Written by the consumer
+  alignas(CacheLine) std::atomic<std::size_t> Tail { 0 };
+  Notifier Room;
+
+  static std::size_t roundUp(std::size_t Capacity) {
+    Expects(Capacity > 0 && Capacity <= std::numeric_limits<std::size_t>::max() / 2 + 1);
+    std::size_t Result = 1;
+    while (Result < Capacity) Result *= 2;
+    return Result;
+  }
+  bool full(std::size_t Position) const noexcept {
+    return Position - Tail.load(std::memory_order_acquire) > Mask;
+  }
+
+public:
+  // Capacity is rounded up to a power of two
+  explicit MessageQueue(std::size_t Capacity, Backpressure Policy = Backpressure::Drop)
+  : Slots(std::make_unique<Message[]>(roundUp(Capacity))), Mask(roundUp(Capacity) - 1)
+  , Policy(Policy) {}
+  MessageQueue(MessageQueue const &) = delete;
+  MessageQueue &operator=(MessageQueue const &) = delete;
+
+  std::size_t capacity() const noexcept { return Mask + 1; }
+  Backpressure policy() const noexcept { return Policy; }
+  std::size_t size() const noexcept {
+    return Head.load(std::memory_order_acquire) - Tail.load(std::memory_order_acquire);
+  }
+  bool empty() const noexcept { return size() == 0; }
+  // Messages discarded by Backpressure::Drop so far
+  std::uint64_t dropped() const noexcept { return Dropped.load(std::memory_order_relaxed); }
+  // Most messages that were pending at once, to size the capacity
+  std::size_t highWater() const noexcept { return HighWater.load(std::memory_order_relaxed); }
+
+  // Producer side, returns false if the message was dropped
+  template<typename T> bool send(T &&Value) {
+    auto const Position = Head.load(std::memory_order_relaxed);
+    if (full(Position)) {
+      if (Policy == Backpressure::Drop) {
+        Dropped.store(Dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+      }
+      Room.wait([&] { return !full(Position); });
+    }
+    Slots[Position & Mask] = std::forward<T>(Value);
+    Head.store(Position + 1, std::memory_order_release);
+    auto const Pending = Position + 1 - Tail.load(std::memory_order_relaxed);
+    if (Pending > HighWater.load(std::memory_order_relaxed)) {
+      HighWater.store(Pending, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  // Consumer side.  Calls handler with each pending message, in order and
+  // with std::visit for variants, up to Limit of them.  Returns the count.
+  template<typename Handler>
+  std::size_t drain(Handler &&handler,
+                    std::size_t Limit = std::numeric_limits<std::size_t>::max()) {
+    auto const Begin = Tail.load(std::memory_order_relaxed);
+    auto const Count = std::min(Head.load(std::memory_order_acquire) - Begin, Limit);
+    for (std::size_t I = 0; I < Count; ++I) {
+      auto const &Slot = Slots[(Begin + I) & Mask];
+      if constexpr (Detail::IsVariant<Message>::value) {
+        std::visit(handler, Slot);
+      } else {
+        handler(Slot);
+      }
+    }
+    if (Count > 0) {
+      Tail.store(Begin + Count, std::memory_order_release);
+      if (Policy == Backpressure::Block) Room.notify();
+    }
+    return Count;
+  }
+};
+
+// Both directions between the real-time thread and one other thread.
+// Events from the real-time thread are dropped rather than delaying a
+// cycle, Commands to it wait for room by default so that no parameter
+// change gets lost.
+template<typename Event, typename Command> struct MessageBus {
+  MessageQueue<Event> Events;
+  MessageQueue<Command> Commands;
+
+  MessageBus(std::size_t EventCapacity, std::size_t CommandCapacity,
+             Backpressure EventPolicy = Backpressure::Drop,
+             Backpressure CommandPolicy = Backpressure::Block)
+  : Events(EventCapacity, EventPolicy), Commands(CommandCapacity, CommandPolicy) {}
+};
+
+} // namespace BrlCV
+
+#endif // BrlCV_MESSAGEBUS_HPP
@@ -1,8 +1,11 @@
 #if !defined(BrlCV_MIDI_HPP)
 #define BrlCV_MIDI_HPP
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
 #include <cstdint>
+#include <optional>
 
 #include <gsl/gsl>
 
@@ -21,7 +24,7 @@ public:
     Expects(Position <= 0b1111111'1111111);
     Ensures(*this == Position);
   }
-  explicit SongPositionPointer(gsl::span<std::byte> Span) : Storage() {
+  explicit SongPositionPointer(gsl::span<std::byte const> Span) : Storage() {
     Expects(Span.size() == 3);
     Expects(Span[0] == std::byte(0XF2));
     Expects(((Span[1] & std::byte(0X80)) | (Span[2] & std::byte(0X80))) == std::byte(0));
@@ -56,6 +59,314 @@ enum class SystemRealTimeMessage {
   Reset         = 0b11111'111
 };
 
+
+enum class MessageType : std::uint8_t {
+  Data,
+  // Channel voice (ControlChange 120-127 are channel mode messages)
+  NoteOff, NoteOn, PolyphonicKeyPressure, ControlChange, ProgramChange,
+  ChannelPressure, PitchBend,
+  // System common
+  SystemExclusive, TimeCodeQuarterFrame, SongPositionPointer, SongSelect,
+  TuneRequest, EndOfExclusive,
+  // System real time
+  Clock, Start, Continue, Stop, ActiveSensing, Reset,
+  Undefined
+};
+
+enum class ChannelMode : std::uint8_t {
+  AllSoundOff = 120, ResetAllControllers, LocalControl, AllNotesOff,
+  OmniOff, OmniOn, MonoOn, PolyOn
+};
+
+// What a byte does to the decoder state
+enum class StatusAction : std::uint8_t {
+  Data, Channel, Common, RealTime, SysExStart, SysExEnd, Undefined
+};
+
+struct StatusInfo {
+  MessageType Type;
+  StatusAction Action;
+  std::uint8_t Size; // Including the status byte, 0 if variable
+};
+
+constexpr StatusInfo statusInfo(unsigned int Byte) noexcept {
+  using Type = MessageType;
+  using Action = StatusAction;
+  constexpr Type ChannelTypes[] = {
+    Type::NoteOff, Type::NoteOn, Type::PolyphonicKeyPressure,
+    Type::ControlChange, Type::ProgramChange, Type::ChannelPressure,
+    Type::PitchBend
+  };
+  constexpr std::uint8_t ChannelSizes[] = { 3, 3, 3, 3, 2, 2, 3 };
+  constexpr StatusInfo SystemInfo[] = {
+    { Type::SystemExclusive, Action::SysExStart, 0 },
+    { Type::TimeCodeQuarterFrame, Action::Common, 2 },
+    { Type::SongPositionPointer, Action::Common, 3 },
+    { Type::SongSelect, Action::Common, 2 },
+    { Type::Undefined, Action::Undefined, 1 },
+    { Type::Undefined, Action::Undefined, 1 },
+    { Type::TuneRequest, Action::Common, 1 },
+    { Type::EndOfExclusive, Action::SysExEnd, 1 },
+    { Type::Clock, Action::RealTime, 1 },
+    { Type::Undefined, Action::RealTime, 1 },
+    { Type::Start, Action::RealTime, 1 },
+    { Type::Continue, Action::RealTime, 1 },
+    { Type::Stop, Action::RealTime, 1 },
+    { Type::Undefined, Action::RealTime, 1 },
+    { Type::ActiveSensing, Action::RealTime, 1 },
+    { Type::Reset, Action::RealTime, 1 }
+  };
+
+  if (Byte < 0X80) return { Type::Data, Action::Data, 0 };
+  if (Byte < 0XF0) {
+    return { ChannelTypes[(Byte >> 4) - 8], Action::Channel, ChannelSizes[(Byte >> 4) - 8] };
+  }
+  return SystemInfo[Byte & 0X0F];
+}
+
+inline constexpr auto StatusTable = [] {
+  std::array<StatusInfo, 256> Table{};
+  for (unsigned int Byte = 0; Byte < Table.size(); ++Byte) {
+    Table[Byte] = statusInfo(Byte);
+  }
+  return Table;
+}();
+
+constexpr StatusInfo const &status(std::byte Byte) noexcept {
+  return StatusTable[std::to_integer<unsigned int>(Byte)];
+}
+
+// A complete message of at most three bytes, everything except SysEx
+class Message {
+  std::array<std::byte, 3> Bytes;
+  std::uint8_t Size;
+
+  static constexpr std::byte channelStatus(unsigned int Nibble, int Channel) {
+    Expects(Channel >= 0 && Channel < 16);
+    return static_cast<std::byte>(Nibble << 4 | Channel);
+  }
+  static constexpr std::byte data(int Value) {
+    Expects(Value >= 0 && Value < 0X80);
+    return static_cast<std::byte>(Value);
+  }
+
+public:
+  constexpr explicit Message(std::byte Status, std::byte Data1 = std::byte(0),
+                             std::byte Data2 = std::byte(0))
+  : Bytes{ Status, Data1, Data2 }, Size(MIDI::status(Status).Size)
+  {
+    Expects(Size != 0);
+    Expects(((Data1 | Data2) & std::byte(0X80)) == std::byte(0));
+  }
+  constexpr Message(SystemRealTimeMessage RealTime)
+  : Message(static_cast<std::byte>(RealTime)) {}
+  Message(SongPositionPointer const &SPP)
+  : Message(*SPP.begin(), *(SPP.begin() + 1), *(SPP.begin() + 2)) {}
+
+  static constexpr Message noteOff(int Channel, int Key, int Velocity = 0) {
+    return Message(channelStatus(0X8, Channel), data(Key), data(Velocity));
+  }
+  static constexpr Message noteOn(int Channel, int Key, int Velocity) {
+    return Message(channelStatus(0X9, Channel), data(Key), data(Velocity));
+  }
+  static constexpr Message polyphonicKeyPressure(int Channel, int Key, int Pressure) {
+    return Message(channelStatus(0XA, Channel), data(Key), data(Pressure));
+  }
+  static constexpr Message controlChange(int Channel, int Controller, int Value) {
+    return Message(channelStatus(0XB, Channel), data(Controller), data(Value));
+  }
+  static constexpr Message channelMode(int Channel, ChannelMode Mode, int Value = 0) {
+    return controlChange(Channel, static_cast<int>(Mode), Value);
+  }
+  static constexpr Message programChange(int Channel, int Program) {
+    return Message(channelStatus(0XC, Channel), data(Program));
+  }
+  static constexpr Message channelPressure(int Channel, int Pressure) {
+    return Message(channelStatus(0XD, Channel), data(Pressure));
+  }
+  // Value is centered at 0X2000
+  static constexpr Message pitchBend(int Channel, int Value) {
+    Expects(Value >= 0 && Value < 1 << 14);
+    return Message(channelStatus(0XE, Channel), data(Value & 0X7F), data(Value >> 7));
+  }
+  static constexpr Message timeCodeQuarterFrame(int Type, int Value) {
+    Expects(Type >= 0 && Type < 8 && Value >= 0 && Value < 16);
+    return Message(std::byte(0XF1), data(Type << 4 | Value));
+  }
+  static constexpr Message songPosition(int Position) {
+    Expects(Position >= 0 && Position < 1 << 14);
+    return Message(std::byte(0XF2), data(Position & 0X7F), data(Position >> 7));
+  }
+  static constexpr Message songSelect(int Song) {
+    return Message(std::byte(0XF3), data(Song));
+  }
+  static constexpr Message tuneRequest() { return Message(std::byte(0XF6)); }
+
+  constexpr MessageType type() const noexcept {
+    return MIDI::status(Bytes[0]).Type;
+  }
+  constexpr bool isChannelMode() const noexcept {
+    return type() == MessageType::ControlChange && Bytes[1] >= std::byte(120);
+  }
+  constexpr std::byte status() const noexcept { return Bytes[0]; }
+  constexpr int channel() const noexcept {
+    return std::to_integer<int>(Bytes[0] & std::byte(0X0F));
+  }
+  constexpr int data1() const noexcept { return std::to_integer<int>(Bytes[1]); }
+  constexpr int data2() const noexcept { return std::to_integer<int>(Bytes[2]); }
+  // 14 bit value of PitchBend and SongPositionPointer
+  constexpr int value14() const noexcept { return data2() << 7 | data1(); }
+
+  constexpr auto begin() const noexcept { return Bytes.begin(); }
+  constexpr auto end() const noexcept { return Bytes.begin() + Size; }
+  constexpr std::size_t size() const noexcept { return Size; }
+  constexpr gsl::span<std::byte const> bytes() const noexcept {
+    return { Bytes.data(), Size };
+  }
+
+  friend constexpr bool operator==(Message const &Lhs, Message const &Rhs) noexcept {
+    return Lhs.Size == Rhs.Size && Lhs.Bytes[0] == Rhs.Bytes[0] &&
+           (Lhs.Size < 2 || Lhs.Bytes[1] == Rhs.Bytes[1]) &&
+           (Lhs.Size < 3 || Lhs.Bytes[2] == Rhs.Bytes[2]);
+  }
+  friend constexpr bool operator!=(Message const &Lhs, Message const &Rhs) noexcept {
+    return !(Lhs == Rhs);
+  }
+};
+
+// Decode one complete event without running status (as delivered by JACK)
+constexpr std::optional<Message> decode(gsl::span<std::byte const> Event) {
+  if (Event.empty()) return std::nullopt;
+  auto const &Info = status(Event[0]);
+  if (Info.Size == 0 || Info.Size != Event.size() || Info.Type == MessageType::Undefined) {
+    return std::nullopt;
+  }
+  for (std::ptrdiff_t I = 1; I < Event.size(); ++I) {
+    if (status(Event[I]).Action != StatusAction::Data) return std::nullopt;
+  }
+  return Message(Event[0], Info.Size > 1 ? Event[1] : std::byte(0),
+                 Info.Size > 2 ? Event[2] : std::byte(0));
+}
+
+// Payload of a complete F0 ... F7 event
+constexpr std::optional<gsl::span<std::byte const>>
+systemExclusive(gsl::span<std::byte const> Event) {
+  if (Event.size() < 2 || Event[0] != std::byte(0XF0) ||
+      Event[Event.size() - 1] != std::byte(0XF7)) {
+    return std::nullopt;
+  }
+  return Event.subspan(1, Event.size() - 2);
+}
+
+// Writes F0 Payload F7 to Out and returns the used part of Out
+constexpr gsl::span<std::byte>
+frameSystemExclusive(gsl::span<std::byte const> Payload, gsl::span<std::byte> Out) {
+  Expects(Out.size() >= Payload.size() + 2);
+  Out[0] = std::byte(0XF0);
+  for (std::ptrdiff_t I = 0; I < Payload.size(); ++I) {
+    Expects((Payload[I] & std::byte(0X80)) == std::byte(0));
+    Out[I + 1] = Payload[I];
+  }
+  Out[Payload.size() + 1] = std::byte(0XF7);
+  return Out.first(Payload.size() + 2);
+}
+
+// Running status compression for byte stream transports
+class Encoder {
+  std::byte Running{0};
+
+public:
+  // The bytes of Message to transmit, without the status byte if it
+  // repeats the running status.
+  constexpr gsl::span<std::byte const> operator()(Message const &Message) noexcept {
+    auto const Status = Message.status();
+    auto const Action = status(Status).Action;
+    bool const Omit = Action == StatusAction::Channel && Status == Running;
+    if (Action != StatusAction::RealTime) {
+      Running = Action == StatusAction::Channel ? Status : std::byte(0);
+    }
+    return Message.bytes().subspan(Omit ? 1 : 0);
+  }
+  gsl::span<std::byte const> operator()(Message const &&) = delete;
+
+  // To be called after sending anything that did not go through this encoder
+  constexpr void reset() noexcept { Running = std::byte(0); }
+};
+
+// Splits a byte stream into messages, expanding running status.  Calls
+// OnMessage(Message) for each complete message and
+// OnSysEx(gsl::span<std::byte const> Payload, bool Complete) for each run
+// of SysEx payload; the span points into the input.
+class Decoder {
+  std::byte Running{0};
+  std::array<std::byte, 2> Data{};
+  std::uint8_t Count = 0, Size = 0;
+  bool KeepStatus = false, SysEx = false;
+
+public:
+  template<typename OnMessage, typename OnSysEx>
+  constexpr void operator()(gsl::span<std::byte const> Bytes,
+                            OnMessage &&onMessage, OnSysEx &&onSysEx) {
+    std::ptrdiff_t SysExStart = 0;
+    auto endSysEx = [&](std::ptrdiff_t End, bool Complete) {
+      if (SysEx) onSysEx(Bytes.subspan(SysExStart, End - SysExStart), Complete);
+      SysEx = false;
+    };
+
+    for (std::ptrdiff_t I = 0; I < Bytes.size(); ++I) {
+      auto const Byte = Bytes[I];
+      auto const &Info = status(Byte);
+      switch (Info.Action) {
+      case StatusAction::Data:
+        if (SysEx || Running == std::byte(0)) break;
+        Data[Count++] = Byte;
+        if (Count + 1 == Size) {
+          onMessage(Message(Running, Data[0], Data[1]));
+          Count = 0;
+          if (!KeepStatus) Running = std::byte(0);
+        }
+        break;
+      case StatusAction::RealTime:
+        if (SysEx) {
+          onSysEx(Bytes.subspan(SysExStart, I - SysExStart), false);
+          SysExStart = I + 1;
+        }
+        if (Info.Type != MessageType::Undefined) onMessage(Message(Byte));
+        break;
+      case StatusAction::SysExStart:
+        endSysEx(I, false);
+        SysEx = true;
+        SysExStart = I + 1;
+        Running = std::byte(0);
+        break;
+      case StatusAction::SysExEnd:
+        endSysEx(I, true);
+        Running = std::byte(0);
+        break;
+      case StatusAction::Channel:
+      case StatusAction::Common:
+        endSysEx(I, false);
+        Running = Byte;
+        Count = 0;
+        Size = Info.Size;
+        KeepStatus = Info.Action == StatusAction::Channel;
+        if (Size == 1) {
+          onMessage(Message(Byte));
+          Running = std::byte(0);
+        }
+        break;
+      case StatusAction::Undefined:
+        endSysEx(I, false);
+        Running = std::byte(0);
+        break;
+      }
+    }
+    if (SysEx && SysExStart < Bytes.size()) {
+      onSysEx(Bytes.subspan(SysExStart), false);
+    }
+  }
+};
+
 } // namespace MIDI
 
 #endif // BrlCV_MIDI_HPP
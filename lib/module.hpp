@@ -0,0 +1,70 @@
+#if !defined(BrlCV_MODULE_HPP)
+#define BrlCV_MODULE_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include <jack.hpp>
+
+namespace JACK {
+
+// The per-cycle work of a tool without a client of its own, so that one
+// client can host several tools and JACK wakes one process for all of
+// them.  Modules create their ports on the client they are given, with a
+// name prefix that keeps the ports of different instances apart.
+class Module {
+public:
+  virtual ~Module() = default;
+
+  // Real-time thread, possibly in parallel with other modules
+  virtual void process(std::uint32_t FrameCount) = 0;
+  // See Client::bufferSizeChanged()
+  virtual void bufferSizeChanged(std::uint32_t /*FrameCount*/) {}
+  // Regularly called by the host's main thread while the client is active
+  virtual void idle() {}
+  // Results, after the client was deactivated
+  virtual void summary(std::ostream &) const {}
+};
+
+// Runs one module as a client of its own.  Implementation is constructed
+// from the client, an empty port prefix and Args, and has a
+//
+//   template<typename Frames> void run(Frames FrameCount);
+//
+// for std::uint32_t and FixedFrames, which is called without a virtual
+// call as in StaticClient.
+template<typename Implementation>
+class ModuleClient final : public StaticClient<ModuleClient<Implementation>> {
+  Implementation Instance;
+
+public:
+  template<typename... Args>
+  ModuleClient(std::string Name, std::optional<Offline> Backend, Args &&...args)
+  : StaticClient<ModuleClient>(std::move(Name), std::move(Backend))
+  , Instance(*this, "", std::forward<Args>(args)...)
+  {}
+  ~ModuleClient() override { this->deactivate(); }
+
+  Implementation &module() noexcept { return Instance; }
+  Implementation const &module() const noexcept { return Instance; }
+
+  int process(std::uint32_t FrameCount) override {
+    Instance.run(FrameCount);
+    return 0;
+  }
+  template<std::uint32_t Size> int process(FixedFrames<Size> FrameCount) {
+    Instance.run(FrameCount);
+    return 0;
+  }
+  int bufferSizeChanged(std::uint32_t FrameCount) override {
+    Instance.bufferSizeChanged(FrameCount);
+    return 0;
+  }
+};
+
+} // namespace JACK
+
+#endif // BrlCV_MODULE_HPP
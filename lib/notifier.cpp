@@ -0,0 +1,62 @@
+#include <notifier.hpp>
+
+#include <cerrno>
+#include <climits>
+#include <system_error>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+long futex(std::atomic<std::uint32_t> &Word, int Operation, std::uint32_t Value,
+           timespec const *Timeout = nullptr) {
+  static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t));
+  return syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&Word),
+                 Operation, Value, Timeout, nullptr, 0);
+}
+
+} // namespace
+
+namespace BrlCV {
+
+void Notifier::wake() noexcept {
+  futex(Sequence, FUTEX_WAKE_PRIVATE, INT_MAX);
+}
+
+bool Notifier::waitChange(std::uint32_t Seen, std::chrono::nanoseconds Timeout) {
+  // FUTEX_WAIT takes a relative timeout, which is recomputed from the
+  // deadline whenever a signal or a spurious wakeup restarts the wait
+  auto const Now = std::chrono::steady_clock::now();
+  bool const Bounded = Timeout < std::chrono::steady_clock::time_point::max() - Now;
+  auto const Deadline = Bounded ? Now + Timeout : std::chrono::steady_clock::time_point::max();
+  timespec Time{};
+
+  Waiters.fetch_add(1);
+  long Result = 0;
+  while (Sequence.load() == Seen) {
+    if (Bounded) {
+      auto const Remaining = Deadline - std::chrono::steady_clock::now();
+      if (Remaining <= Remaining.zero()) {
+        Result = -1;
+        errno = ETIMEDOUT;
+        break;
+      }
+      auto const Seconds = std::chrono::duration_cast<std::chrono::seconds>(Remaining);
+      Time.tv_sec = Seconds.count();
+      Time.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(Remaining - Seconds).count();
+    }
+    Result = futex(Sequence, FUTEX_WAIT_PRIVATE, Seen, Bounded ? &Time : nullptr);
+    if (Result == -1 && errno != EAGAIN && errno != EINTR) break;
+  }
+  Waiters.fetch_sub(1);
+
+  if (Result == -1 && errno == ETIMEDOUT) return false;
+  if (Result == -1 && errno != EAGAIN && errno != EINTR) {
+    throw std::system_error(errno, std::generic_category());
+  }
+  return true;
+}
+
+} // namespace BrlCV
@@ -0,0 +1,64 @@
+#if !defined(BrlCV_NOTIFIER_HPP)
+#define BrlCV_NOTIFIER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace BrlCV {
+
+// Wakes consumer threads from the JACK real-time thread.  notify() takes no
+// locks and does not allocate; it only enters the kernel (futex wake) when
+// a consumer is actually blocked.  Typically paired with a MessageQueue:
+//
+//   RT thread:  Queue.send(Value); Ready.notify();
+//   Consumer:   Ready.wait([&] { return !Queue.empty(); });
+class Notifier {
+  std::atomic<std::uint32_t> Sequence{0};
+  std::atomic<std::uint32_t> Waiters{0};
+
+  void wake() noexcept;
+
+public:
+  Notifier() = default;
+  Notifier(Notifier const &) = delete;
+  Notifier &operator=(Notifier const &) = delete;
+
+  void notify() noexcept {
+    Sequence.fetch_add(1);
+    if (Waiters.load() != 0) wake();
+  }
+
+  std::uint32_t sequence() const noexcept { return Sequence.load(); }
+
+  // Block until notify() was called after sequence() returned Seen.
+  // Returns false on timeout.
+  bool waitChange(std::uint32_t Seen,
+                  std::chrono::nanoseconds Timeout = std::chrono::nanoseconds::max());
+
+  template<typename Predicate> void wait(Predicate Ready) {
+    while (true) {
+      auto const Seen = sequence();
+      if (Ready()) return;
+      waitChange(Seen);
+    }
+  }
+  // Returns Ready() after waiting at most Timeout
+  template<typename Rep, typename Period, typename Predicate>
+  bool waitFor(std::chrono::duration<Rep, Period> Timeout, Predicate Ready) {
+    auto const Deadline = std::chrono::steady_clock::now() + Timeout;
+    while (true) {
+      auto const Seen = sequence();
+      if (Ready()) return true;
+      auto const Remaining = Deadline - std::chrono::steady_clock::now();
+      if (Remaining <= Remaining.zero() ||
+          !waitChange(Seen, std::chrono::duration_cast<std::chrono::nanoseconds>(Remaining))) {
+        return Ready();
+      }
+    }
+  }
+};
+
+} // namespace BrlCV
+
+#endif // BrlCV_NOTIFIER_HPP
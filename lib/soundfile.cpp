@@ -0,0 +1,217 @@
+#define GSL_THROW_ON_CONTRACT_VIOLATION
+#include <soundfile.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+std::uint32_t littleEndian(unsigned char const *Bytes, std::size_t Size) {
+  std::uint32_t Value = 0;
+  for (auto I = Size; I > 0; --I) {
+    Value = (Value << 8) | Bytes[I - 1];
+  }
+  return Value;
+}
+
+template<std::size_t Size> std::uint32_t readLittleEndian(std::istream &Stream) {
+  std::array<unsigned char, Size> Bytes;
+  if (!Stream.read(reinterpret_cast<char *>(Bytes.data()), Size)) {
+    throw std::runtime_error("Unexpected end of WAV file");
+  }
+  return littleEndian(Bytes.data(), Size);
+}
+
+void writeLittleEndian(std::ostream &Stream, std::uint32_t Value, std::size_t Size) {
+  for (std::size_t I = 0; I < Size; ++I) {
+    Stream.put(static_cast<char>((Value >> (8 * I)) & 0XFF));
+  }
+}
+
+bool endsWith(std::string const &String, std::string const &Suffix) {
+  return String.size() >= Suffix.size() &&
+         std::equal(Suffix.rbegin(), Suffix.rend(), String.rbegin());
+}
+
+std::size_t bytesPerSample(BrlCV::SoundFileReader::Encoding Format) {
+  using Encoding = BrlCV::SoundFileReader::Encoding;
+  switch (Format) {
+  case Encoding::PCM16: return 2;
+  case Encoding::PCM24: return 3;
+  case Encoding::PCM32: return 4;
+  case Encoding::Float32: return 4;
+  case Encoding::Float64: return 8;
+  }
+  return 0;
+}
+
+float decode(BrlCV::SoundFileReader::Encoding Format, unsigned char const *Bytes) {
+  using Encoding = BrlCV::SoundFileReader::Encoding;
+  switch (Format) {
+  case Encoding::PCM16:
+    return static_cast<std::int16_t>(littleEndian(Bytes, 2)) / 32768.0F;
+  case Encoding::PCM24:
+    return static_cast<std::int32_t>(littleEndian(Bytes, 3) << 8) / 2147483648.0F;
+  case Encoding::PCM32:
+    return static_cast<std::int32_t>(littleEndian(Bytes, 4)) / 2147483648.0F;
+  case Encoding::Float32: {
+    float Value;
+    auto const Bits = littleEndian(Bytes, 4);
+    std::memcpy(&Value, &Bits, sizeof Value);
+    return Value;
+  }
+  case Encoding::Float64: {
+    double Value;
+    auto const Bits = std::uint64_t(littleEndian(Bytes + 4, 4)) << 32
+                    | littleEndian(Bytes, 4);
+    std::memcpy(&Value, &Bits, sizeof Value);
+    return static_cast<float>(Value);
+  }
+  }
+  return 0;
+}
+
+} // namespace
+
+namespace BrlCV {
+
+SoundFileReader::SoundFileReader(std::string const &Path, unsigned int Channel)
+: Stream(Path, std::ios::binary), Channel(Channel)
+, Remaining(std::numeric_limits<std::uint64_t>::max())
+{
+  if (!Stream) {
+    throw std::runtime_error("Unable to open " + Path);
+  }
+  if (!endsWith(Path, ".wav")) {
+    Expects(Channel == 0);
+    return;
+  }
+  std::array<char, 4> ID;
+  auto readID = [&] {
+    if (!Stream.read(ID.data(), ID.size())) {
+      throw std::runtime_error(Path + ": Unexpected end of WAV file");
+    }
+    return std::string(ID.data(), ID.size());
+  };
+  if (readID() != "RIFF") {
+    throw std::runtime_error(Path + ": Not a RIFF file");
+  }
+  readLittleEndian<4>(Stream);
+  if (readID() != "WAVE") {
+    throw std::runtime_error(Path + ": Not a WAV file");
+  }
+  bool HaveFormat = false;
+  while (true) {
+    auto const Chunk = readID();
+    auto const Size = readLittleEndian<4>(Stream);
+    if (Chunk == "fmt ") {
+      std::vector<unsigned char> Header(Size);
+      if (Size < 16 || !Stream.read(reinterpret_cast<char *>(Header.data()), Size)) {
+        throw std::runtime_error(Path + ": Truncated fmt chunk");
+      }
+      auto Tag = littleEndian(&Header[0], 2);
+      Channels = littleEndian(&Header[2], 2);
+      SampleRate = littleEndian(&Header[4], 4);
+      auto const Bits = littleEndian(&Header[14], 2);
+      if (Tag == 0XFFFE && Size >= 26) { // WAVE_FORMAT_EXTENSIBLE
+        Tag = littleEndian(&Header[24], 2);
+      }
+      if (Tag == 1 && Bits == 16) Format = Encoding::PCM16;
+      else if (Tag == 1 && Bits == 24) Format = Encoding::PCM24;
+      else if (Tag == 1 && Bits == 32) Format = Encoding::PCM32;
+      else if (Tag == 3 && Bits == 32) Format = Encoding::Float32;
+      else if (Tag == 3 && Bits == 64) Format = Encoding::Float64;
+      else {
+        throw std::runtime_error(Path + ": Unsupported WAV sample format");
+      }
+      if (Channel >= Channels) {
+        throw std::runtime_error(Path + ": No channel " + std::to_string(Channel));
+      }
+      HaveFormat = true;
+    } else if (Chunk == "data") {
+      if (!HaveFormat) {
+        throw std::runtime_error(Path + ": data chunk before fmt chunk");
+      }
+      Remaining = Size / (Channels * bytesPerSample(Format));
+      return;
+    } else {
+      Stream.ignore(Size + (Size & 1));
+    }
+  }
+}
+
+std::size_t SoundFileReader::read(gsl::span<float> Buffer) {
+  auto const SampleSize = bytesPerSample(Format);
+  auto const FrameSize = Channels * SampleSize;
+  std::array<unsigned char, 8 * 64> Frame;
+  std::size_t Count = 0;
+
+  if (FrameSize > Frame.size()) {
+    throw std::runtime_error("Too many channels in sound file");
+  }
+  for (auto &Sample: Buffer) {
+    if (Remaining == 0 ||
+        !Stream.read(reinterpret_cast<char *>(Frame.data()), FrameSize)) {
+      Remaining = 0;
+      break;
+    }
+    Sample = decode(Format, Frame.data() + Channel * SampleSize);
+    Remaining -= 1;
+    Count += 1;
+  }
+  std::fill(Buffer.begin() + Count, Buffer.end(), 0.0F);
+
+  return Count;
+}
+
+SoundFileWriter::SoundFileWriter(std::string const &Path, unsigned int SampleRate)
+: Stream(Path, std::ios::binary | std::ios::trunc), WAV(endsWith(Path, ".wav"))
+{
+  if (!Stream) {
+    throw std::runtime_error("Unable to create " + Path);
+  }
+  if (WAV) {
+    Stream.write("RIFF", 4);
+    writeLittleEndian(Stream, 0, 4);
+    Stream.write("WAVEfmt ", 8);
+    writeLittleEndian(Stream, 16, 4);
+    writeLittleEndian(Stream, 3, 2); // IEEE float
+    writeLittleEndian(Stream, 1, 2);
+    writeLittleEndian(Stream, SampleRate, 4);
+    writeLittleEndian(Stream, SampleRate * sizeof(float), 4);
+    writeLittleEndian(Stream, sizeof(float), 2);
+    writeLittleEndian(Stream, 8 * sizeof(float), 2);
+    Stream.write("data", 4);
+    writeLittleEndian(Stream, 0, 4);
+  }
+}
+
+SoundFileWriter::~SoundFileWriter() {
+  if (WAV) {
+    auto const DataSize = static_cast<std::uint32_t>(Frames * sizeof(float));
+    Stream.seekp(4);
+    writeLittleEndian(Stream, 36 + DataSize, 4);
+    Stream.seekp(40);
+    writeLittleEndian(Stream, DataSize, 4);
+  }
+}
+
+void SoundFileWriter::write(gsl::span<float const> Buffer) {
+  if (WAV) {
+    for (auto Sample: Buffer) {
+      std::uint32_t Bits;
+      std::memcpy(&Bits, &Sample, sizeof Bits);
+      writeLittleEndian(Stream, Bits, sizeof Bits);
+    }
+  } else {
+    Stream.write(reinterpret_cast<char const *>(Buffer.data()),
+                 Buffer.size() * sizeof(float));
+  }
+  Frames += Buffer.size();
+}
+
+} // namespace BrlCV
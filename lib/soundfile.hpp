@@ -0,0 +1,56 @@
+#if !defined(BrlCV_SOUNDFILE_HPP)
+#define BrlCV_SOUNDFILE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include <gsl/gsl>
+
+namespace BrlCV {
+
+// Reads one channel of a WAV file (16/24/32 bit PCM or 32/64 bit float) or of
+// a headerless file of native 32 bit floats.
+class SoundFileReader {
+public:
+  enum class Encoding { PCM16, PCM24, PCM32, Float32, Float64 };
+
+private:
+  std::ifstream Stream;
+  Encoding Format = Encoding::Float32;
+  unsigned int Channels = 1, Channel, SampleRate = 0;
+  std::uint64_t Remaining;
+
+public:
+  explicit SoundFileReader(std::string const &Path, unsigned int Channel = 0);
+
+  // Zero for headerless files
+  unsigned int sampleRate() const noexcept { return SampleRate; }
+  unsigned int channels() const noexcept { return Channels; }
+  std::uint64_t remaining() const noexcept { return Remaining; }
+
+  // Fills Buffer and returns the number of frames actually read, the rest
+  // of Buffer is set to zero.
+  std::size_t read(gsl::span<float> Buffer);
+};
+
+// Writes mono 32 bit float audio, as WAV if Path ends in ".wav" and as
+// headerless native floats otherwise.
+class SoundFileWriter {
+  std::ofstream Stream;
+  bool const WAV;
+  std::uint64_t Frames = 0;
+
+public:
+  SoundFileWriter(std::string const &Path, unsigned int SampleRate);
+  ~SoundFileWriter();
+
+  SoundFileWriter(SoundFileWriter const &) = delete;
+  SoundFileWriter &operator=(SoundFileWriter const &) = delete;
+
+  void write(gsl::span<float const> Buffer);
+};
+
+} // namespace BrlCV
+
+#endif // BrlCV_SOUNDFILE_HPP
@@ -0,0 +1,48 @@
+#if !defined(BrlCV_TRIPLEBUFFER_HPP)
+#define BrlCV_TRIPLEBUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace BrlCV {
+
+// Hands the latest value of T from one producer to one consumer thread
+// without locks or allocation.  The producer fills back() completely and
+// publish()es it, the consumer takes the newest published value with
+// update(); values published in between are superseded, never queued.
+template<typename T> class TripleBuffer {
+  static constexpr std::uint8_t Fresh = 0b100, Index = 0b011;
+  std::array<T, 3> Slots;
+  // Slot owned by neither side, with Fresh set while it is unread
+  std::atomic<std::uint8_t> Shared{1};
+  std::uint8_t Back = 0, Front = 2;
+
+public:
+  TripleBuffer() = default;
+  explicit TripleBuffer(T const &Initial) : Slots{{ Initial, Initial, Initial }} {}
+  TripleBuffer(TripleBuffer const &) = delete;
+  TripleBuffer &operator=(TripleBuffer const &) = delete;
+
+  // Producer side.  Holds an older value after publish(), not the last one.
+  T &back() noexcept { return Slots[Back]; }
+  void publish() noexcept {
+    Back = Shared.exchange(Back | Fresh, std::memory_order_acq_rel) & Index;
+  }
+
+  // Consumer side
+  bool fresh() const noexcept {
+    return (Shared.load(std::memory_order_acquire) & Fresh) != 0;
+  }
+  // Returns false and keeps front() if nothing was published since
+  bool update() noexcept {
+    if (!fresh()) return false;
+    Front = Shared.exchange(Front, std::memory_order_acq_rel) & Index;
+    return true;
+  }
+  T const &front() const noexcept { return Slots[Front]; }
+};
+
+} // namespace BrlCV
+
+#endif // BrlCV_TRIPLEBUFFER_HPP
@@ -1,55 +1,79 @@
-#include <jack.hpp>
+#include <module.hpp>
+#include <soundfile.hpp>
 
-#include <boost/accumulators/accumulators.hpp>
-#include <boost/accumulators/statistics.hpp>
-
-template<typename... Features>
-using AudioAccumulatorSet = boost::accumulators::accumulator_set<
-  float, boost::accumulators::features<Features...>
->;
-
-using Count = boost::accumulators::tag::count;
-using Max = boost::accumulators::tag::max;
-using Min = boost::accumulators::tag::min;
-using Mean = boost::accumulators::tag::mean;
-using Variance = boost::accumulators::tag::variance;
-
-class Statistics final : public JACK::Client {
-  JACK::AudioIn In;
-  AudioAccumulatorSet<Count, Max, Mean, Min, Variance> Accumulator;
-
-public:
-  Statistics() : JACK::Client("Statistics"), In(createAudioIn("In")) {}
-  int process(std::uint32_t FrameCount) override {
-    for (auto &Value: In.buffer(FrameCount)) Accumulator(Value);
-    return 0;
-  }
-  auto max() const { return boost::accumulators::max(Accumulator); }
-  auto mean() const { return boost::accumulators::mean(Accumulator); }
-  auto min() const { return boost::accumulators::min(Accumulator); }
-  auto sampleCount() const { return boost::accumulators::count(Accumulator); }
-  auto variance() const { return boost::accumulators::variance(Accumulator); }
-};
+#include "stats.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <string>
 #include <thread>
 
 using std::cout;
 using std::endl;
 using std::this_thread::sleep_for;
-using namespace std::literals::chrono_literals;
 
-int main() {
-  Statistics Client;
+int main(int argc, char *argv[]) {
+  std::size_t ChannelCount = 1;
+  float Lower = -1, Upper = 1;
+  std::chrono::duration<double> Duration = std::chrono::seconds(5);
+  std::vector<std::string> Files;
+  for (int I = 1; I < argc; ++I) {
+    std::string const Argument = argv[I];
+    if (Argument == "-c" && I + 1 < argc) {
+      ChannelCount = std::stoul(argv[++I]);
+    } else if (Argument == "-r" && I + 2 < argc) {
+      Lower = std::stof(argv[++I]);
+      Upper = std::stof(argv[++I]);
+    } else if (Argument == "-t" && I + 1 < argc) {
+      Duration = std::chrono::duration<double>(std::stod(argv[++I]));
+    } else if (Argument.size() > 1 && Argument[0] == '-') {
+      std::cerr << "Usage: " << argv[0]
+                << " [-c CHANNELS] [-r LOW HIGH] [-t SECONDS] [FILE...]" << endl;
+      return EXIT_FAILURE;
+    } else {
+      Files.push_back(Argument);
+    }
+  }
+
+  std::optional<JACK::Offline> Backend;
+  if (!Files.empty()) {
+    Backend.emplace();
+    if (auto Rate = BrlCV::SoundFileReader(Files.front()).sampleRate(); Rate != 0) {
+      Backend->SampleRate = Rate;
+    }
+    for (std::size_t I = 0; I < Files.size(); ++I) {
+      Backend->Files.emplace(Statistics::portName(I), Files[I]);
+    }
+    ChannelCount = Files.size();
+  }
+  JACK::ModuleClient<Statistics> Client("Statistics", std::move(Backend),
+                                        ChannelCount, Lower, Upper);
   cout << "Rate: " << Client.sampleRate() << endl;
 
+  Client.enableTiming();
   Client.activate();
-  sleep_for(5s);
+  // Keep moving the recorded cycles into the timing history while running
+  if (!Files.empty()) {
+    std::atomic<bool> Finished { false };
+    std::thread Replay([&] {
+      Client.wait();
+      Finished = true;
+    });
+    while (!Finished) {
+      Client.pollTiming();
+      sleep_for(std::chrono::milliseconds(1));
+    }
+    Replay.join();
+  } else {
+    auto const End = std::chrono::steady_clock::now() + Duration;
+    while (std::chrono::steady_clock::now() < End) {
+      Client.pollTiming();
+      sleep_for(std::chrono::milliseconds(10));
+    }
+  }
   Client.deactivate();
 
-  cout << Client.sampleCount() << ": "
-       << "mean=" << Client.mean() << ", variance=" << Client.variance()
-       << ", min=" << Client.min() << ", max=" << Client.max()
-       << endl;
+  Client.module().summary(cout);
+  cout << "process(): " << Client.timing() << endl;
 }
@@ -0,0 +1,72 @@
+#if !defined(BrlCV_STATS_HPP)
+#define BrlCV_STATS_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <dsp.hpp>
+#include <jack.hpp>
+#include <module.hpp>
+
+class Statistics final : public JACK::Module {
+public:
+  struct Channel {
+    BrlCV::StreamingStatistics Moments;
+    BrlCV::Histogram Distribution;
+  };
+
+private:
+  std::string const Prefix;
+  float const Lower, Upper;
+  JACK::AudioInArray Ins;
+  std::vector<Channel> Channels;
+
+public:
+  Statistics(JACK::Client &Owner, std::string_view Prefix,
+             std::size_t ChannelCount, float Lower, float Upper)
+  : Prefix(Prefix), Lower(Lower), Upper(Upper)
+  , Ins(Owner.createAudioIns(this->Prefix + "In", ChannelCount))
+  {
+    Expects(ChannelCount > 0);
+    Channels.reserve(ChannelCount);
+    for (std::size_t I = 0; I < ChannelCount; ++I) {
+      Channels.push_back({ {}, BrlCV::Histogram(Lower, Upper) });
+    }
+  }
+  static std::string portName(std::size_t Index) {
+    return "In" + std::to_string(Index + 1);
+  }
+  // FrameCount is std::uint32_t or JACK::FixedFrames
+  template<typename Frames> void run(Frames FrameCount) {
+    auto const Size = static_cast<std::uint32_t>(FrameCount);
+    auto const Buffers = Ins.gather(Size);
+    for (std::size_t I = 0; I < Ins.size(); ++I) {
+      gsl::span<float const> const Buffer(Buffers[I], Size);
+      Channels[I].Moments(Buffer);
+      Channels[I].Distribution(Buffer);
+    }
+  }
+  void process(std::uint32_t FrameCount) override { run(FrameCount); }
+  // Only consistent while the client is not active
+  std::vector<Channel> const &channels() const noexcept { return Channels; }
+
+  void summary(std::ostream &Out) const override {
+    for (std::size_t I = 0; I < Channels.size(); ++I) {
+      auto const &[Moments, Distribution] = Channels[I];
+      Out << Prefix << portName(I) << ' ' << Moments.count() << ": "
+          << "mean=" << Moments.mean() << ", variance=" << Moments.variance()
+          << ", min=" << Moments.min() << ", max=" << Moments.max()
+          << ", p1=" << Distribution.quantile(0.01)
+          << ", p50=" << Distribution.quantile(0.5)
+          << ", p99=" << Distribution.quantile(0.99);
+      if (Distribution.underflow() + Distribution.overflow() > 0) {
+        Out << " (" << Distribution.underflow() + Distribution.overflow()
+            << " outside " << Lower << ".." << Upper << ')';
+      }
+      Out << std::endl;
+    }
+  }
+};
+
+#endif // BrlCV_STATS_HPP